@@ -0,0 +1,244 @@
+#!/usr/bin/env python
+#############################
+#
+#    copyright 2023 Cascoda
+#    Redistribution and use in source and binary forms, with or without modification,
+#    are permitted provided that the following conditions are met:
+#    1.  Redistributions of source code must retain the above copyright notice,
+#        this list of conditions and the following disclaimer.
+#    2.  Redistributions in binary form must reproduce the above copyright notice,
+#        this list of conditions and the following disclaimer in the documentation
+#        and/or other materials provided with the distribution.
+#
+#    THIS SOFTWARE IS PROVIDED "AS IS"
+#    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+#    THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE OR
+#    WARRANTIES OF NON-INFRINGEMENT, ARE DISCLAIMED. IN NO EVENT SHALL THE
+#    CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY,
+#    OR CONSEQUENTIAL DAMAGES
+#    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+#    LOSS OF USE, DATA, OR PROFITS;OR BUSINESS INTERRUPTION)
+#    HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+#    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+#    EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+#############################
+#
+# end to end switch latency benchmark (Linux)
+#
+# starts the virtual switch actuator and push button on this host, installs
+# the Group Object Tables (config/bench_sa.json, config/bench_pb.json) and
+# toggles the push buttons at increasing rates (--bench-rate).
+# Both devices log each data point change with the monotonic time
+# (--bench-log), the logs are matched per press:
+#   press (push button) -> PUT OnOff_N (actuator) -> PUT InfoOnOff_N (push button)
+#
+# usage (from the build folder):
+#   python3 ../bench_switch_latency.py -pb ./knx_iot_virtual_pb
+#       -sa ./knx_iot_virtual_sa
+#       -install ./_deps/knx-iot-stack-build/application_scripts/install_config.py
+#
+import os
+import sys
+import argparse
+import json
+import signal
+import subprocess
+import time
+
+SOURCE_LOCAL = 2   # app_notify_source_t: toggled by the application
+SOURCE_S_MODE = 1  # app_notify_source_t: redirected PUT (s-mode)
+
+# OnOff_N url -> InfoOnOff_N url
+CHANNELS = {"/p/o_1_1": "/p/o_2_2", "/p/o_3_3": "/p/o_4_4",
+            "/p/o_5_5": "/p/o_6_6", "/p/o_7_7": "/p/o_8_8"}
+
+
+def read_log(file_name, source):
+    """ read a bench log: {url: [(time ns, value)]} of the given source """
+    events = {}
+    with open(file_name) as log:
+        for line in log:
+            fields = line.split()
+            if len(fields) != 5 or int(fields[4]) != source:
+                continue
+            events.setdefault(fields[2], []).append(
+                (int(fields[0]), int(fields[3])))
+    return events
+
+
+def match_next(events, start, time_ns, limit_ns, value):
+    """ index of the first event at or after start, in [time_ns, limit_ns)
+        with the value, -1 if there is none """
+    for i in range(start, len(events)):
+        if events[i][0] >= limit_ns:
+            break
+        if events[i][0] >= time_ns and events[i][1] == value:
+            return i
+    return -1
+
+
+def percentile(values, per_mille):
+    """ percentile (nearest rank) of sorted values """
+    if not values:
+        return 0
+    rank = max(1, -(-len(values) * per_mille // 1000))
+    return values[rank - 1]
+
+
+def analyse(presses, sa_events, pb_events, settle_ns):
+    """ match the presses with the PUTs, returns the latencies per leg """
+    legs = {"press->sa": [], "sa->pb": [], "round trip": []}
+    sent = 0
+    lost = 0
+    last = max((p[-1][0] for p in presses.values() if p), default=0)
+    for onoff, info in CHANNELS.items():
+        sa_list = sa_events.get(onoff, [])
+        pb_list = pb_events.get(info, [])
+        sa_pos = 0
+        pb_pos = 0
+        channel = presses.get(onoff, [])
+        for index, (time_ns, value) in enumerate(channel):
+            # the next press with the same value: later events are its own
+            limit_ns = channel[index + 2][0] if index + 2 < len(channel) \
+                else float("inf")
+            if time_ns > last - settle_ns:
+                # still in flight when the push button was stopped
+                break
+            sent += 1
+            sa_index = match_next(sa_list, sa_pos, time_ns, limit_ns, value)
+            if sa_index < 0:
+                lost += 1
+                continue
+            sa_time = sa_list[sa_index][0]
+            sa_pos = sa_index + 1
+            pb_index = match_next(pb_list, pb_pos, sa_time, limit_ns, value)
+            if pb_index < 0:
+                lost += 1
+                continue
+            pb_time = pb_list[pb_index][0]
+            pb_pos = pb_index + 1
+            legs["press->sa"].append(sa_time - time_ns)
+            legs["sa->pb"].append(pb_time - sa_time)
+            legs["round trip"].append(pb_time - time_ns)
+    for values in legs.values():
+        values.sort()
+    return sent, lost, legs
+
+
+def stop(process):
+    """ stop a device with Ctrl-C, so that it flushes its log """
+    process.send_signal(signal.SIGINT)
+    try:
+        process.wait(timeout=10)
+    except subprocess.TimeoutExpired:
+        process.kill()
+        process.wait()
+
+
+def start(args, name, options):
+    """ start a device in the work folder """
+    out = open(os.path.join(args.workdir, name + ".out"), "w")
+    return subprocess.Popen(options, cwd=args.workdir, stdout=out,
+                            stderr=subprocess.STDOUT)
+
+
+def install(args, serial_number, address, config):
+    """ install a Group Object Table with the script of the stack """
+    command = [sys.executable, os.path.abspath(args.install), "-ia", str(address),
+               "-sn", serial_number, "-file", os.path.abspath(config)]
+    print("install:", " ".join(command))
+    subprocess.run(command, cwd=os.path.dirname(os.path.abspath(args.install)),
+                   check=True)
+
+
+if __name__ == '__main__':  # pragma: no cover
+
+    parser = argparse.ArgumentParser()
+
+    parser.add_argument("-pb", "--pushbutton", required=True,
+                        help="the push button executable (knx_iot_virtual_pb)")
+    parser.add_argument("-sa", "--actuator", required=True,
+                        help="the switch actuator executable (knx_iot_virtual_sa)")
+    parser.add_argument("-install", "--install",
+                        help="install_config.py of the stack, not set: the "
+                             "devices are already configured")
+    parser.add_argument("-config", "--config",
+                        default=os.path.join(os.path.dirname(
+                            os.path.abspath(__file__)), "config"),
+                        help="folder with bench_pb.json and bench_sa.json")
+    parser.add_argument("-rates", "--rates", default="10,20,50,100,200,500,1000",
+                        help="presses per second, in increasing order")
+    parser.add_argument("-duration", "--duration", type=float, default=10,
+                        help="seconds per rate")
+    parser.add_argument("-settle", "--settle", type=float, default=1,
+                        help="seconds at the end of a rate that are not measured")
+    parser.add_argument("-max_loss", "--max_loss", type=float, default=0.1,
+                        help="max lost presses (percent) of a sustainable rate")
+    parser.add_argument("-max_p99", "--max_p99", type=float, default=100,
+                        help="max p99 round trip (ms) of a sustainable rate")
+    parser.add_argument("-scopes", "--scopes",
+                        help="--scopes of the push button (default both)")
+    parser.add_argument("-workdir", "--workdir", default="bench_switch_latency",
+                        help="folder for the storage and the logs")
+    parser.add_argument("-json", "--json", help="write the results as json")
+    args = parser.parse_args()
+
+    os.makedirs(args.workdir, exist_ok=True)
+    pb_command = [os.path.abspath(args.pushbutton)]
+    if args.scopes:
+        pb_command += ["--scopes", args.scopes]
+    sa_log = os.path.join(args.workdir, "sa.log")
+    sa = start(args, "sa", [os.path.abspath(args.actuator),
+                            "--bench-log", os.path.abspath(sa_log)])
+    pb_logs = []
+    try:
+        if args.install:
+            pb = start(args, "pb_install", pb_command)
+            time.sleep(3)
+            install(args, "00FA10010700", 6,
+                    os.path.join(args.config, "bench_sa.json"))
+            install(args, "00FA10010400", 5,
+                    os.path.join(args.config, "bench_pb.json"))
+            stop(pb)
+
+        for rate in [float(r) for r in args.rates.split(",")]:
+            pb_log = os.path.join(args.workdir, "pb_%g.log" % rate)
+            print("rate %g presses/s for %g s" % (rate, args.duration))
+            pb = start(args, "pb_%g" % rate,
+                       pb_command + ["--bench-rate", str(rate),
+                                     "--bench-log", os.path.abspath(pb_log)])
+            time.sleep(args.duration)
+            stop(pb)
+            pb_logs.append((rate, pb_log))
+    finally:
+        stop(sa)
+
+    sa_events = read_log(sa_log, SOURCE_S_MODE)
+    results = []
+    sustainable = 0
+    for rate, pb_log in pb_logs:
+        sent, lost, legs = analyse(read_log(pb_log, SOURCE_LOCAL), sa_events,
+                                   read_log(pb_log, SOURCE_S_MODE),
+                                   int(args.settle * 1e9))
+        loss = 100.0 * lost / sent if sent else 100.0
+        result = {"rate": rate, "sent": sent, "lost": lost}
+        print("rate %g: %d presses, %d lost (%.2f%%)" % (rate, sent, lost, loss))
+        for leg, values in legs.items():
+            stats = {"p50": percentile(values, 500) / 1e6,
+                     "p99": percentile(values, 990) / 1e6,
+                     "p999": percentile(values, 999) / 1e6,
+                     "max": (values[-1] if values else 0) / 1e6}
+            result[leg] = stats
+            print("  %-10s p50 %8.3f  p99 %8.3f  p999 %8.3f  max %8.3f ms" %
+                  (leg, stats["p50"], stats["p99"], stats["p999"], stats["max"]))
+        results.append(result)
+        if sent and loss <= args.max_loss and \
+                result["round trip"]["p99"] <= args.max_p99:
+            sustainable = rate
+    print("max sustainable rate: %g presses/s" % sustainable)
+
+    if args.json:
+        with open(args.json, "w") as out:
+            json.dump({"rates": results, "max_sustainable_rate": sustainable},
+                      out, indent=2)
@@ -0,0 +1,553 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * KNX IoT load generator (Linux)
+ *
+ * A client device that sends a configurable mix of requests to the virtual
+ * devices, at a fixed rate:
+ * - get:   unicast GET on a data point
+ * - getm:  unicast GET on a data point with the query ?m=* (metadata)
+ * - put:   unicast PUT on a data point, the value toggles per PUT
+ * - smode: multicast s-mode write to a group address
+ *
+ * The operations are issued open loop: op k is due at start + k / rate,
+ * whatever the responses do. At most --concurrency unicast requests are in
+ * flight; an op that is due while all slots are taken is counted as
+ * dropped. s-mode writes have no response, only their rate is reported.
+ * The latency of a request is measured from the time the op was due, not
+ * from the time it was sent, so the time an op waits for the event loop is
+ * part of the latency (no coordinated omission).
+ * At the end the throughput and the latency percentiles are printed per
+ * operation; the latency is recorded in the log bucket histograms of
+ * knx_iot_virtual_stats.h.
+ *
+ * The stack is only used from the main loop: the load generator is a
+ * device of its own, the requests and the responses run in the event loop.
+ * Requests to devices with OSCORE are rejected: use an unsecured build
+ * (build_unsecured.sh) or devices that are not loaded.
+ */
+#include "oc_api.h"
+#include "oc_rep.h"
+#include "oc_helpers.h"
+#include "port/oc_clock.h"
+
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_shard.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MY_NAME "KNX IoT load generator" /**< The name of the application */
+#define LOADGEN_MAX_SLOTS 256  /**< max unicast requests in flight */
+#define LOADGEN_MAX_URLS 32    /**< max data points addressed */
+#define LOADGEN_DRAIN_SECONDS 3 /**< wait for the responses after the run */
+
+/**
+ * @brief the operations
+ */
+typedef enum {
+  LOADGEN_GET = 0,   /**< unicast GET */
+  LOADGEN_GET_M = 1, /**< unicast GET ?m=* */
+  LOADGEN_PUT = 2,   /**< unicast PUT */
+  LOADGEN_S_MODE = 3, /**< multicast s-mode write */
+  LOADGEN_OPS
+} loadgen_op_t;
+
+static const char *g_op_name[LOADGEN_OPS] = { "get", "getm", "put", "smode" };
+
+/**
+ * @brief the results of an operation
+ */
+typedef struct loadgen_result_t
+{
+  uint32_t issued;        /**< requests sent */
+  uint32_t ok;            /**< 2.xx responses */
+  uint32_t errors;        /**< other responses (incl. timeouts of the stack) */
+  uint32_t dropped;       /**< due while all slots were in flight */
+  uint64_t max_ns;        /**< the slowest response */
+  app_stats_hist_t hist;  /**< latency of the responses */
+} loadgen_result_t;
+
+/**
+ * @brief a unicast request in flight
+ */
+typedef struct loadgen_slot_t
+{
+  bool busy;         /**< in flight */
+  loadgen_op_t op;   /**< the operation */
+  uint64_t due_ns;   /**< time the request was due */
+} loadgen_slot_t;
+
+static volatile int quit = 0; /**< stop variable, used by handle_signal */
+static pthread_mutex_t mutex;
+static pthread_cond_t cv;
+
+/* settings, set by commandline arguments */
+static const char *g_target = NULL;     /**< endpoint of the device */
+static double g_rate = 100;             /**< operations per second */
+static int g_concurrency = 16;          /**< max unicast requests in flight */
+static double g_duration = 10;          /**< seconds */
+static int g_mix[LOADGEN_OPS] = { 1, 1, 1, 1 }; /**< weight per operation */
+static int g_dp_count = 8;              /**< data points /p/o_1_1 .. */
+static uint32_t g_ga_first = 1;         /**< first group address */
+static uint32_t g_ga_last = 8;          /**< last group address */
+static uint64_t g_iid = 16;             /**< installation id of s-mode */
+static int g_sia = 1;                   /**< source address of s-mode */
+static int g_scope = 2;                 /**< multicast scope of s-mode */
+static char g_serial_number[20] = "00FA100105FF";
+
+static oc_endpoint_t g_endpoint;        /**< the parsed target */
+static char g_urls[LOADGEN_MAX_URLS][16];
+static loadgen_slot_t g_slots[LOADGEN_MAX_SLOTS];
+static int g_in_flight = 0;
+static loadgen_result_t g_results[LOADGEN_OPS];
+static uint32_t g_next_url = 0;
+static uint32_t g_next_ga = 0;
+static bool g_put_value = false;
+
+/**
+ * @brief function to set up the device
+ */
+static int
+app_init(void)
+{
+  int ret = oc_init_platform("cascoda", NULL, NULL);
+  ret |= oc_add_device(MY_NAME, "1.0.0", "//", g_serial_number, NULL, NULL);
+  return ret;
+}
+
+/**
+ * @brief the load generator has no resources of its own
+ */
+static void
+register_resources(void)
+{
+}
+
+/**
+ * @brief signal the event loop
+ * wakes up the main function to handle the next callback
+ */
+static void
+signal_event_loop(void)
+{
+  pthread_mutex_lock(&mutex);
+  pthread_cond_signal(&cv);
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * @brief handle Ctrl-C
+ * @param signal the captured signal
+ */
+static void
+handle_signal(int signal)
+{
+  (void)signal;
+  quit = 1;
+}
+
+/**
+ * @brief the response of a unicast request
+ */
+static void
+response_handler(oc_client_response_t *data)
+{
+  loadgen_slot_t *slot = (loadgen_slot_t *)data->user_data;
+  loadgen_result_t *result = &g_results[slot->op];
+  uint64_t ns = app_shard_time_ns() - slot->due_ns;
+
+  // 4.xx, 5.xx and the timeouts of the stack: the codes after NOT_MODIFIED
+  if (data->code > OC_STATUS_NOT_MODIFIED) {
+    result->errors++;
+  } else {
+    result->ok++;
+    app_stats_hist_add(&result->hist, ns);
+    if (ns > result->max_ns) {
+      result->max_ns = ns;
+    }
+  }
+  slot->busy = false;
+  g_in_flight--;
+}
+
+/**
+ * @brief a free slot for a unicast request
+ *
+ * @param op the operation
+ * @param due_ns the time the operation was due
+ * @return the slot, NULL if all slots are in flight
+ */
+static loadgen_slot_t *
+take_slot(loadgen_op_t op, uint64_t due_ns)
+{
+  int i;
+  if (g_in_flight >= g_concurrency) {
+    return NULL;
+  }
+  for (i = 0; i < g_concurrency; i++) {
+    if (g_slots[i].busy == false) {
+      g_slots[i].busy = true;
+      g_slots[i].op = op;
+      g_slots[i].due_ns = due_ns;
+      g_in_flight++;
+      return &g_slots[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief pick the next operation of the mix (weighted random)
+ */
+static loadgen_op_t
+next_op(void)
+{
+  int total = 0;
+  int pick;
+  int op;
+
+  for (op = 0; op < LOADGEN_OPS; op++) {
+    total += g_mix[op];
+  }
+  pick = rand() % total;
+  for (op = 0; op < LOADGEN_OPS - 1; op++) {
+    if (pick < g_mix[op]) {
+      break;
+    }
+    pick -= g_mix[op];
+  }
+  return (loadgen_op_t)op;
+}
+
+/**
+ * @brief issue one operation
+ *
+ * @param op the operation
+ * @param due_ns the time the operation was due
+ */
+static void
+issue(loadgen_op_t op, uint64_t due_ns)
+{
+  loadgen_result_t *result = &g_results[op];
+  loadgen_slot_t *slot;
+  const char *url;
+  bool sent = false;
+
+  if (op == LOADGEN_S_MODE) {
+    /* the value of the s-mode write: CBOR true / false */
+    uint8_t value = g_put_value ? 0xF5 : 0xF4;
+    uint32_t ga = g_ga_first + g_next_ga++ % (g_ga_last - g_ga_first + 1);
+    g_put_value = !g_put_value;
+    oc_issue_s_mode(g_scope, g_sia, ga, ga, g_iid, "w", &value, 1);
+    result->issued++;
+    return;
+  }
+
+  slot = take_slot(op, due_ns);
+  if (slot == NULL) {
+    result->dropped++;
+    return;
+  }
+  url = g_urls[g_next_url++ % (uint32_t)g_dp_count];
+  switch (op) {
+  case LOADGEN_GET:
+    sent =
+      oc_do_get(url, &g_endpoint, NULL, response_handler, LOW_QOS, slot);
+    break;
+  case LOADGEN_GET_M:
+    sent =
+      oc_do_get(url, &g_endpoint, "m=*", response_handler, LOW_QOS, slot);
+    break;
+  case LOADGEN_PUT:
+    if (oc_init_put(url, &g_endpoint, NULL, response_handler, LOW_QOS,
+                    slot)) {
+      oc_rep_begin_root_object();
+      oc_rep_i_set_boolean(root, 1, g_put_value);
+      oc_rep_end_root_object();
+      g_put_value = !g_put_value;
+      sent = oc_do_put();
+    }
+    break;
+  default:
+    break;
+  }
+  if (sent == false) {
+    // the stack has no room for the request (e.g. OC_MAX_NUM_CONCURRENT_REQUESTS)
+    slot->busy = false;
+    g_in_flight--;
+    result->dropped++;
+    return;
+  }
+  result->issued++;
+}
+
+/**
+ * @brief print the results
+ */
+static void
+print_results(double seconds)
+{
+  int op;
+
+  PRINT("%-6s %9s %9s %8s %8s %8s %10s %10s %10s %10s %10s\n", "op",
+        "issued", "ok", "errors", "dropped", "lost", "ok/s", "p50 us",
+        "p99 us", "p999 us", "max us");
+  for (op = 0; op < LOADGEN_OPS; op++) {
+    const loadgen_result_t *result = &g_results[op];
+    uint32_t lost = 0;
+    double rate;
+
+    if (op != LOADGEN_S_MODE) {
+      lost = result->issued - result->ok - result->errors;
+      rate = result->ok / seconds;
+    } else {
+      rate = result->issued / seconds;
+    }
+    PRINT("%-6s %9u %9u %8u %8u %8u %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+          g_op_name[op], result->issued, result->ok, result->errors,
+          result->dropped, lost, rate,
+          app_stats_hist_percentile(&result->hist, 500) / 1e3,
+          app_stats_hist_percentile(&result->hist, 990) / 1e3,
+          app_stats_hist_percentile(&result->hist, 999) / 1e3,
+          result->max_ns / 1e3);
+  }
+}
+
+/**
+ * @brief parse the mix: get=4,getm=1,put=4,smode=1
+ *
+ * @return int 0 == success
+ */
+static int
+parse_mix(const char *text)
+{
+  int mix[LOADGEN_OPS] = { 0 };
+  int total = 0;
+  int op;
+
+  while (*text != '\0') {
+    for (op = 0; op < LOADGEN_OPS; op++) {
+      size_t len = strlen(g_op_name[op]);
+      if (strncmp(text, g_op_name[op], len) == 0 && text[len] == '=') {
+        break;
+      }
+    }
+    if (op == LOADGEN_OPS) {
+      return -1;
+    }
+    text += strlen(g_op_name[op]) + 1;
+    mix[op] = atoi(text);
+    total += mix[op];
+    while (*text != '\0' && *text != ',') {
+      text++;
+    }
+    if (*text == ',') {
+      text++;
+    }
+  }
+  if (total <= 0) {
+    return -1;
+  }
+  memcpy(g_mix, mix, sizeof(g_mix));
+  return 0;
+}
+
+/**
+ * @brief print usage and quits
+ */
+static void
+print_usage(void)
+{
+  PRINT("Usage:\n");
+  PRINT("--target <endpoint> : the device, e.g. coap://[::1]:5683 (required)\n");
+  PRINT("--rate <N> : operations per second (default 100)\n");
+  PRINT("--concurrency <N> : max unicast requests in flight (default 16)\n");
+  PRINT("--duration <seconds> : duration of the run (default 10)\n");
+  PRINT("--mix <op=weight,...> : ops get, getm (?m=*), put, smode\n");
+  PRINT("      (default get=1,getm=1,put=1,smode=1)\n");
+  PRINT("--dp <N> : data points /p/o_1_1 .. /p/o_N_N (default 8)\n");
+  PRINT("--ga <first>-<last> : group addresses of smode (default 1-8)\n");
+  PRINT("--iid <N> : installation id of smode (default 16)\n");
+  PRINT("--sia <N> : source individual address of smode (default 1)\n");
+  PRINT("--scope <N> : multicast scope of smode (default 2)\n");
+  PRINT("-s <serial number> : serial number of the load generator\n");
+  exit(0);
+}
+
+/**
+ * @brief wait until the time (monotonic ns), or until the stack signals
+ */
+static void
+wait_until(uint64_t deadline_ns)
+{
+  struct timespec ts;
+  pthread_mutex_lock(&mutex);
+  ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+  ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+  pthread_cond_timedwait(&cv, &mutex, &ts);
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * @brief main application.
+ * starts the stack, issues the operations at the rate, prints the results
+ */
+int
+main(int argc, char *argv[])
+{
+  static oc_handler_t handler = { .init = app_init,
+                                  .signal_event_loop = signal_event_loop,
+                                  .register_resources = register_resources,
+                                  .requests_entry = NULL };
+  pthread_condattr_t attr;
+  struct sigaction sa;
+  oc_string_t target;
+  oc_clock_time_t next_event;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint64_t period_ns;
+  uint64_t due_ns;
+  uint64_t now;
+  uint64_t wake_ns;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "--help") == 0) {
+      print_usage();
+    }
+  }
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--target") == 0) {
+      g_target = argv[i + 1];
+    }
+    if (strcmp(argv[i], "--rate") == 0) {
+      g_rate = atof(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--concurrency") == 0) {
+      g_concurrency = atoi(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--duration") == 0) {
+      g_duration = atof(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--mix") == 0 && parse_mix(argv[i + 1]) != 0) {
+      print_usage();
+    }
+    if (strcmp(argv[i], "--dp") == 0) {
+      g_dp_count = atoi(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--ga") == 0 &&
+        sscanf(argv[i + 1], "%u-%u", &g_ga_first, &g_ga_last) != 2) {
+      print_usage();
+    }
+    if (strcmp(argv[i], "--iid") == 0) {
+      g_iid = strtoull(argv[i + 1], NULL, 0);
+    }
+    if (strcmp(argv[i], "--sia") == 0) {
+      g_sia = atoi(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--scope") == 0) {
+      g_scope = atoi(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "-s") == 0) {
+      strncpy(g_serial_number, argv[i + 1], sizeof(g_serial_number) - 1);
+    }
+  }
+  if (g_target == NULL || g_rate <= 0 || g_duration <= 0 ||
+      g_concurrency < 1 || g_concurrency > LOADGEN_MAX_SLOTS ||
+      g_dp_count < 1 || g_dp_count > LOADGEN_MAX_URLS ||
+      g_ga_last < g_ga_first) {
+    print_usage();
+  }
+  for (i = 0; i < g_dp_count; i++) {
+    snprintf(g_urls[i], sizeof(g_urls[i]), "/p/o_%d_%d", i + 1, i + 1);
+  }
+
+  sigfillset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sa.sa_handler = handle_signal;
+  sigaction(SIGINT, &sa, NULL);
+
+  /* the deadlines are monotonic (app_shard_time_ns) */
+  pthread_mutex_init(&mutex, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cv, &attr);
+
+  oc_storage_config("./knx_iot_loadgen_creds");
+  if (oc_main_init(&handler) < 0) {
+    PRINT("oc_main_init failed, exiting.\n");
+    return 1;
+  }
+  oc_new_string(&target, g_target, strlen(g_target));
+  if (oc_string_to_endpoint(&target, &g_endpoint, NULL) != 0) {
+    PRINT("invalid target %s\n", g_target);
+    oc_free_string(&target);
+    oc_main_shutdown();
+    return 1;
+  }
+  oc_free_string(&target);
+
+  PRINT("%s: %s, %.1f ops/s, concurrency %d, %.1f s\n", MY_NAME, g_target,
+        g_rate, g_concurrency, g_duration);
+  period_ns = (uint64_t)(1e9 / g_rate);
+  start_ns = app_shard_time_ns();
+  end_ns = start_ns + (uint64_t)(g_duration * 1e9);
+  due_ns = start_ns;
+
+  while (quit != 1) {
+    next_event = oc_main_poll();
+    now = app_shard_time_ns();
+    while (due_ns <= now && due_ns < end_ns) {
+      issue(next_op(), due_ns);
+      due_ns += period_ns;
+    }
+    if (now >= end_ns + LOADGEN_DRAIN_SECONDS * 1000000000ULL ||
+        (now >= end_ns && g_in_flight == 0)) {
+      break;
+    }
+    wake_ns = (due_ns < end_ns) ? due_ns
+                                : end_ns + LOADGEN_DRAIN_SECONDS * 1000000000ULL;
+    if (next_event != 0) {
+      /* the next callback of the stack, in stack clock ticks */
+      oc_clock_time_t ticks = oc_clock_time();
+      uint64_t stack_ns =
+        (next_event > ticks)
+          ? now + (next_event - ticks) * (1000000000ULL / OC_CLOCK_SECOND)
+          : now;
+      if (stack_ns < wake_ns) {
+        wake_ns = stack_ns;
+      }
+    }
+    if (wake_ns > now) {
+      wait_until(wake_ns);
+    }
+  }
+
+  now = app_shard_time_ns();
+  print_results((double)(((now < end_ns) ? now : end_ns) - start_ns) / 1e9);
+  oc_main_shutdown();
+  return 0;
+}
@@ -0,0 +1,400 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * microbenchmarks of the application layer (Linux)
+ *
+ * Linked with knx_iot_virtual_sa.c (knx_iot_microbench_sa) or
+ * knx_iot_virtual_pb.c (knx_iot_microbench_pb, KNX_MICROBENCH_PB), both
+ * built with NO_MAIN. The stack is started (app_initialize_stack, with the
+ * storage folder knx_iot_microbench_<app>_creds) but not polled: the
+ * benchmarks call the functions and the data point handlers directly, the
+ * handlers get fake requests with a response buffer.
+ * The PUT benchmark parses the CBOR payload ({1: bool}, encoded once) in
+ * each iteration, as the stack does for a received request.
+ *
+ * Each benchmark doubles its iterations until it runs --benchmark_min_time
+ * seconds. The output follows Google Benchmark: a table on the console,
+ * or JSON with --benchmark_format=json (stdout) or --benchmark_out=<file>,
+ * with real_time and cpu_time per iteration in ns.
+ */
+#include "oc_api.h"
+#include "oc_rep.h"
+#include "oc_helpers.h"
+
+#ifdef KNX_MICROBENCH_PB
+#include "knx_iot_virtual_pb.h"
+#define MICROBENCH_APP "pb"
+#else
+#include "knx_iot_virtual_sa.h"
+#define MICROBENCH_APP "sa"
+#endif
+/**
+ * own storage folder: the credentials and the journal of the application
+ * are not touched
+ */
+#define MICROBENCH_STORAGE "./knx_iot_microbench_" MICROBENCH_APP "_creds"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_shard.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MICROBENCH_BUFFER 1024 /**< response buffer of the fake requests */
+#define MICROBENCH_MAX_ITERATIONS 1000000000ULL
+
+/**
+ * @brief a benchmark: runs the function iterations times
+ */
+typedef struct microbench_t
+{
+  const char *name;                 /**< the benchmark name */
+  void (*run)(uint64_t iterations); /**< the benchmark loop */
+} microbench_t;
+
+/**
+ * @brief the result of a benchmark
+ */
+typedef struct microbench_result_t
+{
+  uint64_t iterations; /**< iterations of the measured run */
+  double real_ns;      /**< wall clock time per iteration */
+  double cpu_ns;       /**< process cpu time per iteration */
+} microbench_result_t;
+
+static volatile bool g_sink;              /**< keeps the results alive */
+static char g_bool_url[32];               /**< a boolean data point */
+static char g_fault_url[32];              /**< a data point with a fault */
+static const app_dp_t *g_get_dp = NULL;   /**< the data point of GET */
+static const app_dp_t *g_put_dp = NULL;   /**< the data point of PUT */
+
+/* the fake request */
+static uint8_t g_buffer[MICROBENCH_BUFFER];
+static oc_response_buffer_t g_response_buffer;
+static oc_response_t g_response;
+static oc_endpoint_t g_origin;
+static oc_resource_t g_get_resource; /**< resolves to g_get_dp */
+static oc_resource_t g_put_resource; /**< resolves to g_put_dp */
+static oc_request_t g_request;
+static uint8_t g_put_cbor[2][16]; /**< {1: false} and {1: true} */
+static int g_put_cbor_size[2];    /**< the sizes of the encoded payloads */
+
+/**
+ * @brief prepare the fake request (and the encoder) for one call
+ */
+static void
+microbench_request(oc_resource_t *resource, const char *query,
+                   oc_rep_t *payload)
+{
+  g_response_buffer.buffer = g_buffer;
+  g_response_buffer.buffer_size = sizeof(g_buffer);
+  g_response_buffer.response_length = 0;
+  g_response.response_buffer = &g_response_buffer;
+  g_request.response = &g_response;
+  g_request.origin = &g_origin;
+  g_request.resource = resource;
+  g_request.query = query;
+  g_request.query_len = (query != NULL) ? strlen(query) : 0;
+  g_request.request_payload = payload;
+  g_request.accept = APPLICATION_CBOR;
+  g_request.content_format = APPLICATION_CBOR;
+  oc_rep_new(g_buffer, sizeof(g_buffer));
+}
+
+static void
+bm_retrieve_bool(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    g_sink = app_retrieve_bool_variable(g_bool_url);
+  }
+}
+
+static void
+bm_set_bool(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    app_set_bool_variable(g_bool_url, (iterations & 1) != 0);
+  }
+}
+
+static void
+bm_set_fault(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    app_set_fault_variable(g_fault_url, (iterations & 1) != 0);
+  }
+}
+
+static void
+bm_get(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    microbench_request(&g_get_resource, NULL, NULL);
+    app_dp_get_handler(&g_request, OC_IF_A, NULL);
+  }
+}
+
+static void
+bm_get_meta(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    microbench_request(&g_get_resource, "m=*", NULL);
+    app_dp_get_handler(&g_request, OC_IF_A, NULL);
+  }
+}
+
+static void
+bm_put(uint64_t iterations)
+{
+  while (iterations-- > 0) {
+    int value = (int)(iterations & 1);
+    oc_rep_t *payload = NULL;
+    if (oc_parse_rep(g_put_cbor[value], g_put_cbor_size[value], &payload) !=
+        0) {
+      fprintf(stderr, "microbench: can't parse the PUT payload\n");
+      exit(1);
+    }
+    microbench_request(&g_put_resource, NULL, payload);
+    app_dp_put_handler(&g_request, OC_IF_A, NULL);
+    oc_free_rep(payload);
+  }
+}
+
+/**
+ * @brief encode the payloads of the PUT benchmark: {1: false}, {1: true}
+ */
+static void
+microbench_encode_put(void)
+{
+  int value;
+  for (value = 0; value < 2; value++) {
+    oc_rep_new(g_put_cbor[value], sizeof(g_put_cbor[value]));
+    oc_rep_begin_root_object();
+    oc_rep_i_set_boolean(root, 1, value != 0);
+    oc_rep_end_root_object();
+    g_put_cbor_size[value] = oc_rep_get_encoded_payload_size();
+  }
+}
+
+/**
+ * @brief the benchmarks, in the order of the output
+ */
+static const microbench_t g_benchmarks[] = {
+  { "BM_app_retrieve_bool_variable", bm_retrieve_bool },
+  { "BM_app_set_bool_variable", bm_set_bool },
+  { "BM_app_set_fault_variable", bm_set_fault },
+  { "BM_get_handler", bm_get },
+  { "BM_get_handler_meta", bm_get_meta },
+  { "BM_put_handler", bm_put },
+};
+
+/**
+ * @brief process cpu time in nanoseconds
+ */
+static uint64_t
+microbench_cpu_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief run a benchmark, doubling the iterations until min_time is reached
+ */
+static microbench_result_t
+microbench_run(const microbench_t *bm, double min_time)
+{
+  microbench_result_t result;
+  uint64_t iterations = 1;
+  uint64_t real;
+  uint64_t cpu;
+
+  while (1) {
+    real = app_shard_time_ns();
+    cpu = microbench_cpu_ns();
+    bm->run(iterations);
+    real = app_shard_time_ns() - real;
+    cpu = microbench_cpu_ns() - cpu;
+    if (real >= (uint64_t)(min_time * 1e9) ||
+        iterations >= MICROBENCH_MAX_ITERATIONS) {
+      break;
+    }
+    iterations *= 2;
+  }
+  result.iterations = iterations;
+  result.real_ns = (double)real / (double)iterations;
+  result.cpu_ns = (double)cpu / (double)iterations;
+  return result;
+}
+
+/**
+ * @brief write the results as JSON (Google Benchmark layout)
+ */
+static void
+microbench_json(FILE *out, const char *executable,
+                const microbench_result_t *results, const bool *selected)
+{
+  char date[32];
+  time_t now = time(NULL);
+  size_t i;
+  bool first = true;
+
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+  fprintf(out, "{\n  \"context\": {\n");
+  fprintf(out, "    \"date\": \"%s\",\n", date);
+  fprintf(out, "    \"executable\": \"%s\",\n", executable);
+  fprintf(out, "    \"application\": \"%s\",\n", MICROBENCH_APP);
+  fprintf(out, "    \"num_cpus\": %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+  fprintf(out, "  },\n  \"benchmarks\": [");
+  for (i = 0; i < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); i++) {
+    if (selected[i] == false) {
+      continue;
+    }
+    fprintf(out, "%s\n    {\n", first ? "" : ",");
+    fprintf(out, "      \"name\": \"%s\",\n", g_benchmarks[i].name);
+    fprintf(out, "      \"run_name\": \"%s\",\n", g_benchmarks[i].name);
+    fprintf(out, "      \"run_type\": \"iteration\",\n");
+    fprintf(out, "      \"iterations\": %llu,\n",
+            (unsigned long long)results[i].iterations);
+    fprintf(out, "      \"real_time\": %.3f,\n", results[i].real_ns);
+    fprintf(out, "      \"cpu_time\": %.3f,\n", results[i].cpu_ns);
+    fprintf(out, "      \"time_unit\": \"ns\"\n    }");
+    first = false;
+  }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+/**
+ * @brief print usage and quits
+ */
+static void
+print_usage(void)
+{
+  PRINT("Usage:\n");
+  PRINT("--benchmark_filter=<text> : only the benchmarks with text in the name\n");
+  PRINT("--benchmark_min_time=<seconds> : min time per benchmark (default 0.5)\n");
+  PRINT("--benchmark_format=<console|json> : output on stdout\n");
+  PRINT("--benchmark_out=<file> : writes the results as json to file\n");
+  exit(0);
+}
+
+/**
+ * @brief find the data points used by the benchmarks
+ *
+ * @return int 0 == success
+ */
+static int
+microbench_select_dps(void)
+{
+  int i;
+  for (i = 0; i < app_dp_count(); i++) {
+    const app_dp_t *dp = app_dp_get(i);
+    if (g_get_dp == NULL) {
+      g_get_dp = dp;
+      strncpy(g_bool_url, dp->url, sizeof(g_bool_url) - 1);
+    }
+    if (g_put_dp == NULL && (dp->flags & APP_DP_FLAG_WRITABLE) != 0) {
+      g_put_dp = dp;
+    }
+    if (g_fault_url[0] == '\0' && (dp->flags & APP_DP_FLAG_FAULT) != 0) {
+      strncpy(g_fault_url, dp->url, sizeof(g_fault_url) - 1);
+    }
+  }
+  return (g_get_dp != NULL && g_put_dp != NULL) ? 0 : -1;
+}
+
+/**
+ * @brief main: starts the stack, runs the benchmarks, prints the results
+ */
+int
+main(int argc, char *argv[])
+{
+  microbench_result_t results[sizeof(g_benchmarks) / sizeof(g_benchmarks[0])];
+  bool selected[sizeof(g_benchmarks) / sizeof(g_benchmarks[0])];
+  const char *filter = NULL;
+  const char *out_file = NULL;
+  bool json = false;
+  double min_time = 0.5;
+  size_t i;
+
+  for (int a = 1; a < argc; a++) {
+    if (strncmp(argv[a], "--benchmark_filter=", 19) == 0) {
+      filter = argv[a] + 19;
+    } else if (strncmp(argv[a], "--benchmark_min_time=", 21) == 0) {
+      min_time = atof(argv[a] + 21);
+    } else if (strcmp(argv[a], "--benchmark_format=json") == 0) {
+      json = true;
+    } else if (strcmp(argv[a], "--benchmark_format=console") == 0) {
+      json = false;
+    } else if (strncmp(argv[a], "--benchmark_out=", 16) == 0) {
+      out_file = argv[a] + 16;
+    } else {
+      print_usage();
+    }
+  }
+
+  app_set_storage_folder(MICROBENCH_STORAGE);
+  if (app_initialize_stack() < 0 || microbench_select_dps() != 0) {
+    fprintf(stderr, "microbench: can't start the application\n");
+    return 1;
+  }
+  /* the handlers resolve the data point from the url of the resource */
+  oc_new_string(&g_get_resource.uri, g_get_dp->url, strlen(g_get_dp->url));
+  oc_new_string(&g_put_resource.uri, g_put_dp->url, strlen(g_put_dp->url));
+  microbench_encode_put();
+
+  if (json == false) {
+    printf("%-32s %14s %14s %12s\n", "Benchmark", "Time", "CPU",
+           "Iterations");
+  }
+  for (i = 0; i < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); i++) {
+    selected[i] =
+      (filter == NULL || strstr(g_benchmarks[i].name, filter) != NULL);
+    if (selected[i] == false) {
+      continue;
+    }
+    results[i] = microbench_run(&g_benchmarks[i], min_time);
+    if (json == false) {
+      printf("%-32s %11.1f ns %11.1f ns %12llu\n", g_benchmarks[i].name,
+             results[i].real_ns, results[i].cpu_ns,
+             (unsigned long long)results[i].iterations);
+    }
+  }
+
+  if (json) {
+    microbench_json(stdout, argv[0], results, selected);
+  }
+  if (out_file != NULL) {
+    FILE *out = fopen(out_file, "w");
+    if (out == NULL) {
+      fprintf(stderr, "microbench: can't open %s\n", out_file);
+      oc_main_shutdown();
+      return 1;
+    }
+    microbench_json(out, argv[0], results, selected);
+    fclose(out);
+  }
+  oc_main_shutdown();
+  return 0;
+}
@@ -19,298 +19,232 @@
 
 //#define NO_MAIN
 #include "knx_iot_virtual_pb.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_state.h"
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_journal.h"
+#include "knx_iot_virtual_swu.h"
+#include "knx_iot_virtual_got.h"
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_pi_hat.h"
 
 #include "api/oc_knx_dev.h"
 #include "api/oc_knx_fp.h"
 
 
-#include <Python.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <signal.h>
 #include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
 
 static volatile int quit = 0;  /**< stop variable, used by handle_signal */
-static pthread_mutex_t mutex;
-static pthread_cond_t cv;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
 static struct timespec ts;
+static bool g_wakeup = false; /**< event loop signalled, protected by mutex */
+static int g_signal_pipe[2] = { -1, -1 }; /**< Ctrl-C to the signal thread */
 
-PyObject *pModule;
-PyObject *pSetBacklightFunc;
-PyObject *pSetLedFunc;
-
+/**
+ * the urls toggled by the touch buttons: left, mid, right, up, down, cancel
+ */
+static const char *g_button_url[] = { "/p/o_1_1", "/p/o_3_3", "/p/o_5_5",
+                                      "/p/o_7_7", "/p/o_9_9", "/p/o_11_11" };
+/** bit per touch button: pressed, s-mode message not yet sent */
+static uint32_t g_button_pressed = 0;
 
-// Action to take on left button press "/p/1" OnOff_1
-// This is exposed in the corresponding Python script
-// as the knx.handle_left() function
-static PyObject *
-knx_handle_left(PyObject *self, PyObject *args)
+/**
+ * @brief wakes up the main loop
+ * called by signal_event_loop (stack) and by the touch buttons (touch thread)
+ */
+static void
+wakeup_main_loop(void)
 {
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("Left from C! (/p/o_1_1) \n");
-  char url[] = "/p/o_1_1";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
-  }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
+  pthread_mutex_lock(&mutex);
+  g_wakeup = true;
+  pthread_cond_signal(&cv);
+  pthread_mutex_unlock(&mutex);
 }
 
-// Action to take on mid button press "/p/3" OnOff_2
-// This is exposed in the corresponding Python script
-// as the knx.handle_mid() function
-static PyObject *
-knx_handle_mid(PyObject *self, PyObject *args)
+/**
+ * @brief wait until the next event of the stack, or until woken up
+ *
+ * @param next_event the time of the next event, 0 == no event scheduled
+ */
+static void
+wait_main_loop(oc_clock_time_t next_event)
 {
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("Mid from C!  (/p/o_3_3)\n");  
-  char url[] = "/p/o_3_3";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
+  pthread_mutex_lock(&mutex);
+  if (g_wakeup == false) {
+    if (next_event == 0) {
+      pthread_cond_wait(&cv, &mutex);
+    } else {
+      ts.tv_sec = (next_event / OC_CLOCK_SECOND);
+      ts.tv_nsec = (next_event % OC_CLOCK_SECOND) * 1.e09 / OC_CLOCK_SECOND;
+      pthread_cond_timedwait(&cv, &mutex, &ts);
+    }
   }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
+  g_wakeup = false;
+  pthread_mutex_unlock(&mutex);
 }
 
-// Action to take on right button press "/p/5" of OnOff_3 
-// This is exposed in the corresponding Python script
-// as the knx.handle_right() function
-static PyObject *
-knx_handle_right(PyObject *self, PyObject *args)
+/**
+ * @brief handle a touch button press (touch thread)
+ * toggles the value in the state store, the s-mode message is sent by the
+ * main loop: the stack is only used from the main thread.
+ *
+ * @param button the button index in g_button_url (pi_hat_button_t)
+ */
+static void
+button_pressed(int button)
 {
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("Right from C! (/p/o_5_5)\n");
-  char url[] = "/p/o_5_5";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
-  }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
+  const char *url = g_button_url[button];
+  app_state_toggle(app_state_store(0), app_dp_index(app_dp_find(url)));
+  __atomic_fetch_or(&g_button_pressed, 1u << button, __ATOMIC_ACQ_REL);
+  wakeup_main_loop();
 }
 
-// Action to take on up button press "/p/7" of OnOff_4 
-// This is exposed in the corresponding Python script
-// as the knx.handle_up() function
-static PyObject *
-knx_handle_up(PyObject *self, PyObject *args)
+/**
+ * @brief queue the s-mode messages of the pressed buttons (main thread)
+ * sent in one batch by the next poll
+ */
+static void
+send_pressed_buttons(void)
 {
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("UP from C! (/p/o_7_7)\n");
-  char url[] = "/p/o_7_7";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
+  uint32_t pressed =
+    __atomic_exchange_n(&g_button_pressed, 0, __ATOMIC_ACQ_REL);
+  int button;
+  for (button = 0; pressed != 0; button++, pressed >>= 1) {
+    if (pressed & 1) {
+      app_smode_queue_url(g_button_url[button], app_smode_scopes());
+    }
   }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
 }
 
 
-// Action to take on down button press (not yet mapped)
-// This is exposed in the corresponding Python script
-// as the knx.handle_down() function
-static PyObject *
-knx_handle_down(PyObject *self, PyObject *args)
-{
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("Down from C! (/p/o_9_9)\n");
-  char url[] = "/p/o_9_9";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
-  }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
-}
-
-// Action to take on cancel button press(not yet mapped)
-// This is exposed in the corresponding Python script
-// as the knx.handle_cancel() function
-static PyObject *
-knx_handle_cancel(PyObject *self, PyObject *args)
+/**
+ * @brief the touch callback of the Pi hat (touch thread)
+ *
+ * @param button the touched button
+ */
+static void
+touch_callback(pi_hat_button_t button)
 {
-  // don't care about args, so don't check them
-  (void)self;
-  (void)args;
-  printf("Cancel from C! (/p/o_11_11)\n");
-  char url[] = "/p/o_11_11";
-  bool p1 = app_retrieve_bool_variable(url);
-  if (p1 == true) {
-    p1 = false;
-  } else {
-    p1 = true;
-  }
-  app_set_bool_variable(url, p1);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
-  Py_RETURN_NONE;
+  printf("Touch %d from C! (%s)\n", (int)button, g_button_url[button]);
+  button_pressed((int)button);
 }
 
-
-// Definition of the methods within the knx module.
-// Extend this array if you need to add more Python->C functions
-static PyMethodDef KnxMethods[] = {
-  { "handle_left", knx_handle_left, METH_NOARGS,
-    "Inform KNX of left button press" },
-  { "handle_mid", knx_handle_mid, METH_NOARGS,
-    "Inform KNX of mid button press" },
-  { "handle_right", knx_handle_right, METH_NOARGS,
-    "Inform KNX of right button press" },
-  { "handle_up", knx_handle_up, METH_NOARGS,
-    "Inform KNX of up button press" },
-  { "handle_down", knx_handle_down, METH_NOARGS,
-    "Inform KNX of down button press" },
-  { "handle_cancel", knx_handle_cancel, METH_NOARGS,
-    "Inform KNX of cancel button press" },
-  { NULL, NULL, 0, NULL }
-};
-
-// Boilerplate to initialize the knx module
-static PyModuleDef KnxModule = {
-  PyModuleDef_HEAD_INIT, "knx", NULL, -1, KnxMethods, NULL, NULL, NULL, NULL
-};
-
-static PyObject *
-PyInit_knx(void)
+/**
+ * the LED of the graph per data point, other 2 not yet mapped
+ */
+static const struct
 {
-  return PyModule_Create(&KnxModule);
-}
+  const char *url;
+  int led;
+} g_led_dp[] = { { "/p/o_2_2", 1 }, { "/p/o_4_4", 2 },
+                 { "/p/o_6_6", 3 }, { "/p/o_8_8", 4 } };
 
-void
-python_binding_init(void)
+/**
+ * @brief shows the value of a data point on its LED
+ * subscribed per data point (the LED number is the user data)
+ */
+static void
+led_callback(const app_notify_event_t *events, int count, void *user_data)
 {
-  Py_Initialize();
-
-  // Import the Python module that talks to the Displayotron HAT
-  PyObject *pName = PyUnicode_DecodeFSDefault("pi_hat");
-
-  // Add current directory to Python path, so that we may import the module
-  // located in the same folder as the executable
-  PyRun_SimpleString("import sys");
-  PyRun_SimpleString("import os");
-  PyRun_SimpleString("sys.path.append(os.getcwd())");
-
-  pModule = PyImport_Import(pName);
-  Py_DECREF(pName);
-
-  if (pModule) {
-    // Import the test function, to check the import is successful
-    // & that we are importing the right script
-    PyObject *pPrintInPythonFunc =
-      PyObject_GetAttrString(pModule, "print_in_python");
-
-    if (pPrintInPythonFunc && PyCallable_Check(pPrintInPythonFunc)) {
-      // Ensure that the Python embedding is successful
-      PyObject *pValue = PyObject_CallObject(pPrintInPythonFunc, NULL);
+  int led = (int)(intptr_t)user_data;
+  for (int i = 0; i < count; i++) {
+    if (events[i].device == 0) {
+      pi_hat_set_led(led, events[i].new_value);
     }
-    // Do not need the test function anymore, so we decrement the reference
-    // counter so that the memory for this object can be garbage-collected
-    Py_DECREF(pPrintInPythonFunc);
-
-    // Import the rest of the Python API
-    pSetBacklightFunc = PyObject_GetAttrString(pModule, "set_backlight");
-    pSetLedFunc = PyObject_GetAttrString(pModule, "set_led");
-
-    // Initialize the state of the LCD
-    PyRun_SimpleString("import pi_hat");
-    PyRun_SimpleString("pi_hat.init()");
-
-  } else {
-    PyErr_Print();
-    fprintf(stderr, "Failed to load pi_hat\n");
-    fprintf(stderr, "Please ensure that pi_hat.py is in the directory "
-                    "you are running this executable from!\n");
-    exit(1);
   }
 }
 
-void
-set_led(int led_nr, bool value)
+/**
+ * @brief subscribe the LEDs to their data points
+ * called after the data point registry is initialized (app_initialize_stack)
+ * the LEDs show the current values first: the values restored from the
+ * journal do not cause a notification
+ */
+static void
+subscribe_leds(void)
 {
-  if (pSetLedFunc && PyCallable_Check(pSetLedFunc)) {
-    // When called from C, Python functions expect a single tuple argument
-    // containing the arguments defined in the API
-    PyObject *pArgs = PyTuple_New(2);
-    PyObject *pArgTheZeroth = PyLong_FromLong(led_nr);
-    PyObject *pArgTheFirst = PyBool_FromLong(value);
-    PyTuple_SetItem(pArgs, 0, pArgTheZeroth);
-    PyTuple_SetItem(pArgs, 1, pArgTheFirst);
-
-    PyObject *pReturn = PyObject_Call(pSetLedFunc, pArgs, NULL);
-    PyErr_Print();
-
-    // cleanup - must free every temporary Python object
-    Py_DECREF(pArgs);
-    Py_DECREF(pArgTheZeroth);
-    Py_DECREF(pArgTheFirst);
-    Py_DECREF(pReturn);
-  } else {
-    PyErr_Print();
-    fprintf(stderr, "set_led was not called successfully!");
+  size_t i;
+  for (i = 0; i < sizeof(g_led_dp) / sizeof(g_led_dp[0]); i++) {
+    app_notify_subscribe_url(g_led_dp[i].url, 0, led_callback,
+                             (void *)(intptr_t)g_led_dp[i].led);
+    pi_hat_set_led(g_led_dp[i].led,
+                   app_retrieve_bool_variable((char *)g_led_dp[i].url));
   }
 }
 
-void put_callback(char* url){
-  bool my_bool = app_retrieve_bool_variable(url);
-  if (strcmp(url, "/p/o_2_2") == 0) set_led(1, my_bool);
-  if (strcmp(url, "/p/o_4_4") == 0) set_led(2, my_bool);
-  if (strcmp(url, "/p/o_6_6") == 0) set_led(3, my_bool);
-  if (strcmp(url, "/p/o_8_8") == 0) set_led(4, my_bool);
-  // other 2 not yet mapped
-}
-
-static void *
-poll_python(void *data)
+/**
+ * @brief dump the trace ring and the stats on stdout (SIGUSR1)
+ * @param signal the captured signal
+ */
+static void
+handle_trace_signal(int signal)
 {
-  PyErr_CheckSignals();
-  if (PyRun_SimpleString("signal.sigtimedwait([], 0.001)") != 0) {
-    printf("Python poll error!\n");
-    PyErr_Print();
-    quit = 1;
-  }
+  (void)signal;
+  app_trace_dump_fd(STDOUT_FILENO);
+  app_stats_dump_fd(STDOUT_FILENO);
 }
 
 /**
  * @brief handle Ctrl-C
+ * the main loop is woken up by the signal thread: a signal handler can't
+ * use the mutex, writing to the pipe is async-signal-safe
  * @param signal the captured signal
  */
 static void
 handle_signal(int signal)
 {
+  int saved_errno = errno;
   (void)signal;
-  //signal_event_loop();
   quit = 1;
+  if (g_signal_pipe[1] >= 0) {
+    ssize_t ret = write(g_signal_pipe[1], "q", 1);
+    (void)ret;
+  }
+  errno = saved_errno;
+}
+
+/**
+ * @brief the signal thread: wakes up the main loop after Ctrl-C
+ */
+static void *
+signal_thread(void *data)
+{
+  char c;
+  (void)data;
+  while (read(g_signal_pipe[0], &c, 1) < 0 && errno == EINTR) {
+  }
+  wakeup_main_loop();
+  return NULL;
+}
+
+/**
+ * @brief start the signal thread, before installing handle_signal
+ * @return int 0 == success
+ */
+static int
+start_signal_thread(void)
+{
+  pthread_t thread;
+  if (pipe(g_signal_pipe) != 0) {
+    return -1;
+  }
+  if (pthread_create(&thread, NULL, signal_thread, NULL) != 0) {
+    close(g_signal_pipe[0]);
+    close(g_signal_pipe[1]);
+    g_signal_pipe[0] = g_signal_pipe[1] = -1;
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
 }
 
 /**
@@ -327,50 +261,52 @@ main(void)
   oc_clock_time_t next_event;
 
   /* Linux specific */
+  if (start_signal_thread() != 0) {
+    fprintf(stderr, "can't start the signal thread\n");
+    exit(1);
+  }
   struct sigaction sa;
   sigfillset(&sa.sa_mask);
   sa.sa_flags = 0;
   sa.sa_handler = handle_signal;
   /* install Ctrl-C */
   sigaction(SIGINT, &sa, NULL);
+  /* kill -USR1 dumps the trace ring */
+  sa.sa_handler = handle_trace_signal;
+  sigaction(SIGUSR1, &sa, NULL);
   /* Disable full buffering so stdout appears in journalctl */
   setvbuf(stdout, NULL, _IONBF, BUFSIZ);
-  PyImport_AppendInittab("knx", PyInit_knx);
 
-  Py_Initialize();
-  PyObject *pName = PyUnicode_DecodeFSDefault("pi_hat");
-  PyRun_SimpleString("import sys");
-  PyRun_SimpleString("import os");
-  PyRun_SimpleString("import signal");
-  PyRun_SimpleString("sys.path.append(os.getcwd())");
-
-  pModule = PyImport_Import(pName);
-  Py_DECREF(pName);
-
-  // initialize the PiHat - prints stuff to the LCD
-  PyRun_SimpleString("import pi_hat");
-  PyRun_SimpleString("pi_hat.init_client()");
+  // Initialize the Pi hat, the touch buttons call touch_callback
+  // prints stuff to the LCD
+  if (pi_hat_init("init_client", touch_callback) != 0) {
+    exit(1);
+  }
 
-  // needed to for the info data points
-  app_set_put_cb(put_callback);
+  // the stack wakes up the main loop
+  app_set_wakeup_cb(wakeup_main_loop);
 
   app_initialize_stack();
+  // the LEDs show the info data points
+  subscribe_leds();
 
-  // Start the embedded Python interpreter and initialize the Python API
-  // Necessary for controlling the backlight
-  python_binding_init();
-  // Set the backlight to the initial value
-  // set_backlight(g_mystate);
-  // set_backlight(true);
-
-  /* Linux specific loop */
+  /* Linux specific loop
+     the touch thread and the output thread of the Pi hat run independently */
   while (quit != 1) {
-    oc_main_poll();
-    poll_python(NULL);
+    send_pressed_buttons();
+    next_event = oc_main_poll();
+    // the tables can be rewritten while loading
+    app_got_check_load_state();
+    app_meta_check_load_state();
+    // hand the LEDs changed during the poll to the output thread
+    pi_hat_flush();
+    wait_main_loop(next_event);
   }
 
   /* shut down the stack */
 exit:
   oc_main_shutdown();
+  app_swu_shutdown();
+  app_journal_close();
   return 0;
 }
@@ -0,0 +1,264 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * Pi hat backend using Python: pi_hat.py (dothat)
+ *
+ * The touch buttons are handled by a Python thread of dothat, which calls
+ * the built-in knx module (knx.handle_left() ...); the module forwards the
+ * presses to the touch callback.
+ * After the initialization the main loop releases the interpreter lock for
+ * good: Python is only called by the output thread, which takes the lock
+ * per call.
+ * PyObject_Vectorcall is available from Python 3.9, older versions use
+ * PyObject_CallFunctionObjArgs (same arguments, no tuple caching).
+ */
+#include <Python.h>
+
+#include "knx_iot_pi_hat_backend.h"
+
+#include <stdio.h>
+
+static PyObject *g_module = NULL;        /**< the pi_hat module */
+static PyObject *g_set_backlight = NULL; /**< pi_hat.set_backlight */
+static PyObject *g_set_leds = NULL;      /**< pi_hat.set_leds */
+
+static pi_hat_touch_cb_t g_touch_cb = NULL; /**< touch button callback */
+static PyThreadState *g_py_state = NULL;    /**< main thread (released) */
+
+/**
+ * @brief forward a touch button press to the touch callback
+ */
+static PyObject *
+pi_hat_touch(pi_hat_button_t button)
+{
+  if (g_touch_cb) {
+    g_touch_cb(button);
+  }
+  Py_RETURN_NONE;
+}
+
+// Actions to take on the button presses
+// These are exposed in pi_hat.py as the knx.handle_xxx() functions
+static PyObject *
+knx_handle_left(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_LEFT);
+}
+
+static PyObject *
+knx_handle_mid(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_MID);
+}
+
+static PyObject *
+knx_handle_right(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_RIGHT);
+}
+
+static PyObject *
+knx_handle_up(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_UP);
+}
+
+static PyObject *
+knx_handle_down(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_DOWN);
+}
+
+static PyObject *
+knx_handle_cancel(PyObject *self, PyObject *args)
+{
+  (void)self;
+  (void)args;
+  return pi_hat_touch(PI_HAT_CANCEL);
+}
+
+// Definition of the methods within the knx module.
+// Extend this array if you need to add more Python->C functions
+static PyMethodDef KnxMethods[] = {
+  { "handle_left", knx_handle_left, METH_NOARGS,
+    "Inform KNX of left button press" },
+  { "handle_mid", knx_handle_mid, METH_NOARGS,
+    "Inform KNX of mid button press" },
+  { "handle_right", knx_handle_right, METH_NOARGS,
+    "Inform KNX of right button press" },
+  { "handle_up", knx_handle_up, METH_NOARGS,
+    "Inform KNX of up button press" },
+  { "handle_down", knx_handle_down, METH_NOARGS,
+    "Inform KNX of down button press" },
+  { "handle_cancel", knx_handle_cancel, METH_NOARGS,
+    "Inform KNX of cancel button press" },
+  { NULL, NULL, 0, NULL }
+};
+
+// Boilerplate to initialize the knx module
+static PyModuleDef KnxModule = {
+  PyModuleDef_HEAD_INIT, "knx", NULL, -1, KnxMethods, NULL, NULL, NULL, NULL
+};
+
+static PyObject *
+PyInit_knx(void)
+{
+  return PyModule_Create(&KnxModule);
+}
+
+/**
+ * @brief retrieve a callable of the pi_hat module
+ *
+ * @param name the name of the function
+ * @return the callable (new reference), NULL if not found
+ */
+static PyObject *
+pi_hat_callable(const char *name)
+{
+  PyObject *func = PyObject_GetAttrString(g_module, name);
+  if (func == NULL || PyCallable_Check(func) == 0) {
+    PyErr_Clear();
+    Py_XDECREF(func);
+    fprintf(stderr, "pi_hat.%s not found!\n", name);
+    return NULL;
+  }
+  return func;
+}
+
+/**
+ * @brief call a Python function with 1 or 2 arguments
+ * prints the Python error (if any)
+ * the caller holds the interpreter lock
+ */
+static void
+pi_hat_call(PyObject *func, PyObject *arg0, PyObject *arg1)
+{
+  PyObject *result;
+  if (func == NULL) {
+    return;
+  }
+#if PY_VERSION_HEX >= 0x03090000
+  PyObject *args[2] = { arg0, arg1 };
+  result = PyObject_Vectorcall(func, args, (arg1 != NULL) ? 2 : 1, NULL);
+#else
+  result = PyObject_CallFunctionObjArgs(func, arg0, arg1, NULL);
+#endif
+  if (result == NULL) {
+    PyErr_Print();
+    return;
+  }
+  Py_DECREF(result);
+}
+
+int
+pi_hat_backend_init(const char *init_function, pi_hat_touch_cb_t touch_cb)
+{
+  g_touch_cb = touch_cb;
+  PyImport_AppendInittab("knx", PyInit_knx);
+  Py_Initialize();
+
+  // Add current directory to Python path, so that we may import the module
+  // located in the same folder as the executable
+  PyRun_SimpleString("import sys");
+  PyRun_SimpleString("import os");
+  PyRun_SimpleString("sys.path.append(os.getcwd())");
+
+  // Import the Python module that talks to the Displayotron HAT
+  PyObject *name = PyUnicode_DecodeFSDefault("pi_hat");
+  g_module = PyImport_Import(name);
+  Py_DECREF(name);
+  if (g_module == NULL) {
+    PyErr_Print();
+    fprintf(stderr, "Failed to load pi_hat\n");
+    fprintf(stderr, "Please ensure that pi_hat.py is in the directory "
+                    "you are running this executable from!\n");
+    return -1;
+  }
+
+  // Ensure that the Python embedding is successful
+  PyObject *print_func = pi_hat_callable("print_in_python");
+  if (print_func) {
+    PyObject *result = PyObject_CallObject(print_func, NULL);
+    Py_XDECREF(result);
+    Py_DECREF(print_func);
+  }
+
+  // the API used from C, looked up once
+  g_set_backlight = pi_hat_callable("set_backlight");
+  g_set_leds = pi_hat_callable("set_leds");
+
+  // Initialize the state of the LCD
+  PyObject *init_func = pi_hat_callable(init_function);
+  if (init_func) {
+    PyObject *result = PyObject_CallObject(init_func, NULL);
+    if (result == NULL) {
+      PyErr_Print();
+    }
+    Py_XDECREF(result);
+    Py_DECREF(init_func);
+  }
+
+  // the output thread and the touch thread take the lock when needed
+  g_py_state = PyEval_SaveThread();
+  return 0;
+}
+
+void
+pi_hat_backend_set_backlight(bool value)
+{
+  PyGILState_STATE gil = PyGILState_Ensure();
+  pi_hat_call(g_set_backlight, value ? Py_True : Py_False, NULL);
+  PyGILState_Release(gil);
+}
+
+void
+pi_hat_backend_set_leds(uint32_t mask, uint32_t values)
+{
+  static PyObject *masks = NULL; /**< cache of the mask/value integers */
+  PyGILState_STATE gil = PyGILState_Ensure();
+
+  if (masks == NULL) {
+    // all combinations of PI_HAT_MAX_LEDS bits (64 integers)
+    int i;
+    masks = PyTuple_New(1 << PI_HAT_MAX_LEDS);
+    if (masks == NULL) {
+      PyErr_Print();
+      PyGILState_Release(gil);
+      return;
+    }
+    for (i = 0; i < (1 << PI_HAT_MAX_LEDS); i++) {
+      PyTuple_SET_ITEM(masks, i, PyLong_FromLong(i));
+    }
+  }
+  pi_hat_call(g_set_leds, PyTuple_GET_ITEM(masks, mask),
+              PyTuple_GET_ITEM(masks, values));
+  PyGILState_Release(gil);
+}
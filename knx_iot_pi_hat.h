@@ -0,0 +1,116 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * bridge from the Raspberry Pi demos to the Pi hat (Displayotron HAT).
+ *
+ * Two backends implement this interface, selected at build time with the
+ * cmake option PI_HAT_BACKEND:
+ * - python (knx_iot_pi_hat.c): embeds Python and uses pi_hat.py (dothat).
+ *   The Python callables are looked up once at initialization, the calls
+ *   use vectorcall with cached argument objects (Py_True/Py_False and small
+ *   integers), so a call does not allocate Python objects.
+ * - native (knx_iot_pi_hat_native.c): talks directly over i2c to the SN3218
+ *   (backlight) and the CAP1166 (touch, graph LEDs), see knx_iot_pi_hat_i2c.h
+ *   for the i2c bus and its mock.
+ *
+ * The writes to the hat are done by an output thread (knx_iot_pi_hat_output.c):
+ * the main loop only queues the changes, so a slow hat does not delay the
+ * stack. The changes are handed over with pi_hat_flush, once per main loop
+ * iteration.
+ * All functions except the touch callback are called from the main loop.
+ */
+#ifndef KNX_IOT_PI_HAT_H
+#define KNX_IOT_PI_HAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PI_HAT_MAX_LEDS 6 /**< LEDs of the graph on the Pi hat */
+
+/**
+ * @brief the touch buttons of the Pi hat
+ */
+typedef enum {
+  PI_HAT_LEFT = 0,   /**< left */
+  PI_HAT_MID = 1,    /**< middle (button) */
+  PI_HAT_RIGHT = 2,  /**< right */
+  PI_HAT_UP = 3,     /**< up */
+  PI_HAT_DOWN = 4,   /**< down */
+  PI_HAT_CANCEL = 5, /**< cancel */
+  PI_HAT_BUTTONS = 6 /**< number of buttons */
+} pi_hat_button_t;
+
+/**
+ * Callback invoked when a touch button is pressed
+ * called from the touch thread of the backend (not the main loop)
+ *
+ * @param button the button
+ */
+typedef void (*pi_hat_touch_cb_t)(pi_hat_button_t button);
+
+/**
+ * @brief initialize the Pi hat
+ * python: starts the interpreter, loads pi_hat.py from the current working
+ * directory and calls the initialization function.
+ * native: opens the i2c bus, initializes the chips and starts the touch
+ * thread.
+ * Then starts the output thread.
+ *
+ * @param init_function the initialization of the hat,
+ * "init" (actuator) or "init_client" (push button)
+ * @param touch_cb the callback for the touch buttons, may be NULL
+ * @return int 0 == success
+ */
+int pi_hat_init(const char *init_function, pi_hat_touch_cb_t touch_cb);
+
+/**
+ * @brief set the backlight of the LCD on or off
+ * the change is written by the output thread after the next pi_hat_flush
+ *
+ * @param value the backlight state
+ */
+void pi_hat_set_backlight(bool value);
+
+/**
+ * @brief set the state of a LED of the graph
+ * the change is written by the output thread after the next pi_hat_flush
+ *
+ * @param led_nr the LED number (0 .. PI_HAT_MAX_LEDS - 1)
+ * @param value the LED state
+ */
+void pi_hat_set_led(int led_nr, bool value);
+
+/**
+ * @brief hand the queued changes over to the output thread
+ * the output thread writes only the last state of each changed output, with
+ * one write (Python call or i2c transfer) for all changed LEDs
+ */
+void pi_hat_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_PI_HAT_H */
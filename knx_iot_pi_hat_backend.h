@@ -0,0 +1,66 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * interface between the Pi hat output thread (knx_iot_pi_hat_output.c) and
+ * the backends (python: knx_iot_pi_hat.c, native: knx_iot_pi_hat_native.c).
+ *
+ * pi_hat_backend_init is called from the main loop, the set functions only
+ * from the output thread.
+ */
+#ifndef KNX_IOT_PI_HAT_BACKEND_H
+#define KNX_IOT_PI_HAT_BACKEND_H
+
+#include "knx_iot_pi_hat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief initialize the hardware of the Pi hat
+ *
+ * @param init_function "init" (actuator) or "init_client" (push button)
+ * @param touch_cb the callback for the touch buttons, may be NULL
+ * @return int 0 == success
+ */
+int pi_hat_backend_init(const char *init_function,
+                        pi_hat_touch_cb_t touch_cb);
+
+/**
+ * @brief write the backlight of the LCD
+ *
+ * @param value the backlight state
+ */
+void pi_hat_backend_set_backlight(bool value);
+
+/**
+ * @brief write the LEDs of the graph
+ *
+ * @param mask bit per LED to update
+ * @param values bit per LED with the new state
+ */
+void pi_hat_backend_set_leds(uint32_t mask, uint32_t values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_PI_HAT_BACKEND_H */
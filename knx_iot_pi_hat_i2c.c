@@ -0,0 +1,235 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * i2c bus of the native Pi hat backend: Linux i2c device and mock
+ *
+ * The bus is shared by the main loop (LEDs) and the touch thread, each
+ * transfer is done under the bus mutex.
+ */
+#include "knx_iot_pi_hat_i2c.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#endif
+
+#define PI_HAT_I2C_MAX_WRITE 32 /**< max registers per write */
+
+struct pi_hat_i2c_t
+{
+  pthread_mutex_t mutex; /**< one transfer at the time */
+  int fd;                /**< the i2c device, -1 == mock */
+  int address;           /**< the selected chip, -1 == none */
+  uint8_t regs[128][256]; /**< mock: the registers per chip address */
+  pthread_t stdin_thread; /**< mock: reads the touch buttons from stdin */
+};
+
+/**
+ * @brief the channels of the touch controller, by name (mock input)
+ */
+static const struct
+{
+  const char *name;
+  uint8_t channel;
+} g_mock_buttons[] = { { "cancel", 0 }, { "up", 1 },    { "down", 2 },
+                       { "left", 3 },   { "right", 4 }, { "mid", 5 } };
+
+/**
+ * @brief mock: reads button names from stdin and "touches" them
+ */
+static void *
+pi_hat_i2c_mock_stdin(void *data)
+{
+  pi_hat_i2c_t *bus = (pi_hat_i2c_t *)data;
+  char line[80];
+  size_t i;
+
+  printf("pi_hat mock: type a button (left, mid, right, up, down, cancel)\n");
+  while (fgets(line, sizeof(line), stdin) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    for (i = 0; i < sizeof(g_mock_buttons) / sizeof(g_mock_buttons[0]); i++) {
+      if (strcmp(line, g_mock_buttons[i].name) == 0) {
+        pthread_mutex_lock(&bus->mutex);
+        bus->regs[PI_HAT_CAP1166_ADDRESS][PI_HAT_CAP1166_INPUT_STATUS] |=
+          (uint8_t)(1u << g_mock_buttons[i].channel);
+        bus->regs[PI_HAT_CAP1166_ADDRESS][PI_HAT_CAP1166_MAIN_CONTROL] |=
+          PI_HAT_CAP1166_INT;
+        pthread_mutex_unlock(&bus->mutex);
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief mock: apply a register write
+ */
+static void
+pi_hat_i2c_mock_write(pi_hat_i2c_t *bus, uint8_t address, uint8_t reg,
+                      const uint8_t *data, size_t len)
+{
+  size_t i;
+  printf("pi_hat mock: i2c 0x%02X reg 0x%02X:", address, reg);
+  for (i = 0; i < len; i++) {
+    printf(" %02X", data[i]);
+    bus->regs[address & 0x7F][(uint8_t)(reg + i)] = data[i];
+  }
+  printf("\n");
+  if (address == PI_HAT_CAP1166_ADDRESS &&
+      reg == PI_HAT_CAP1166_MAIN_CONTROL &&
+      (data[0] & PI_HAT_CAP1166_INT) == 0) {
+    /* clearing the interrupt releases the (mock) touch */
+    bus->regs[address][PI_HAT_CAP1166_INPUT_STATUS] = 0;
+  }
+}
+
+pi_hat_i2c_t *
+pi_hat_i2c_open(const char *device)
+{
+  const char *env = getenv("PI_HAT_I2C");
+  pi_hat_i2c_t *bus;
+
+  if (env != NULL && env[0] != '\0') {
+    device = env;
+  }
+  bus = (pi_hat_i2c_t *)calloc(1, sizeof(pi_hat_i2c_t));
+  if (bus == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&bus->mutex, NULL);
+  bus->fd = -1;
+  bus->address = -1;
+
+  if (strcmp(device, PI_HAT_I2C_MOCK) == 0) {
+    printf("pi_hat: i2c mock\n");
+    if (pthread_create(&bus->stdin_thread, NULL, pi_hat_i2c_mock_stdin,
+                       bus) == 0) {
+      pthread_detach(bus->stdin_thread);
+    }
+    return bus;
+  }
+#ifdef __linux__
+  bus->fd = open(device, O_RDWR);
+#endif
+  if (bus->fd < 0) {
+    fprintf(stderr, "pi_hat: can't open %s (%d)\n", device, errno);
+    pthread_mutex_destroy(&bus->mutex);
+    free(bus);
+    return NULL;
+  }
+  printf("pi_hat: i2c %s\n", device);
+  return bus;
+}
+
+void
+pi_hat_i2c_close(pi_hat_i2c_t *bus)
+{
+  if (bus == NULL || bus->fd < 0) {
+    /* mock: the (detached) stdin thread keeps using the bus */
+    return;
+  }
+  close(bus->fd);
+  pthread_mutex_destroy(&bus->mutex);
+  free(bus);
+}
+
+#ifdef __linux__
+/**
+ * @brief select the chip on the bus
+ */
+static int
+pi_hat_i2c_select(pi_hat_i2c_t *bus, uint8_t address)
+{
+  if (bus->address == address) {
+    return 0;
+  }
+  if (ioctl(bus->fd, I2C_SLAVE, address) < 0) {
+    bus->address = -1;
+    return -1;
+  }
+  bus->address = address;
+  return 0;
+}
+#endif /* __linux__ */
+
+int
+pi_hat_i2c_write(pi_hat_i2c_t *bus, uint8_t address, uint8_t reg,
+                 const uint8_t *data, size_t len)
+{
+  uint8_t buffer[PI_HAT_I2C_MAX_WRITE + 1];
+  int ret = 0;
+
+  if (bus == NULL || len == 0 || len > PI_HAT_I2C_MAX_WRITE) {
+    return -1;
+  }
+  pthread_mutex_lock(&bus->mutex);
+  if (bus->fd < 0) {
+    pi_hat_i2c_mock_write(bus, address, reg, data, len);
+  } else {
+#ifdef __linux__
+    buffer[0] = reg;
+    memcpy(&buffer[1], data, len);
+    if (pi_hat_i2c_select(bus, address) != 0 ||
+        write(bus->fd, buffer, len + 1) != (ssize_t)(len + 1)) {
+      ret = -1;
+    }
+#else
+    (void)buffer;
+    ret = -1;
+#endif
+  }
+  pthread_mutex_unlock(&bus->mutex);
+  return ret;
+}
+
+int
+pi_hat_i2c_read(pi_hat_i2c_t *bus, uint8_t address, uint8_t reg,
+                uint8_t *value)
+{
+  int ret = 0;
+
+  if (bus == NULL || value == NULL) {
+    return -1;
+  }
+  pthread_mutex_lock(&bus->mutex);
+  if (bus->fd < 0) {
+    *value = bus->regs[address & 0x7F][reg];
+  } else {
+#ifdef __linux__
+    if (pi_hat_i2c_select(bus, address) != 0 ||
+        write(bus->fd, &reg, 1) != 1 || read(bus->fd, value, 1) != 1) {
+      ret = -1;
+    }
+#else
+    ret = -1;
+#endif
+  }
+  pthread_mutex_unlock(&bus->mutex);
+  return ret;
+}
@@ -0,0 +1,112 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * i2c bus of the native Pi hat backend.
+ *
+ * The bus is either a Linux i2c device (/dev/i2c-N) or a mock, which keeps
+ * the registers of the chips in memory and logs the writes.
+ * The mock emulates the touch controller: the button names read from stdin
+ * (left, mid, right, up, down, cancel) set the input status and interrupt
+ * bits, so the touch handling of the backend can be tested without hardware.
+ */
+#ifndef KNX_IOT_PI_HAT_I2C_H
+#define KNX_IOT_PI_HAT_I2C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PI_HAT_I2C_MOCK "mock" /**< device name of the mock bus */
+
+/* the chips of the Pi hat (Displayotron HAT) */
+#define PI_HAT_SN3218_ADDRESS 0x54  /**< LED driver of the backlight */
+#define PI_HAT_SN3218_SHUTDOWN 0x00 /**< 1 == normal operation */
+#define PI_HAT_SN3218_PWM 0x01      /**< first of the 18 PWM registers */
+#define PI_HAT_SN3218_ENABLE 0x13   /**< 3 LED enable registers (6 bits) */
+#define PI_HAT_SN3218_UPDATE 0x16   /**< write: apply PWM and enable */
+#define PI_HAT_SN3218_CHANNELS 18   /**< 6 RGB zones */
+
+#define PI_HAT_CAP1166_ADDRESS 0x2C      /**< touch and graph LEDs */
+#define PI_HAT_CAP1166_MAIN_CONTROL 0x00 /**< bit 0: interrupt */
+#define PI_HAT_CAP1166_INT 0x01          /**< interrupt bit */
+#define PI_HAT_CAP1166_INPUT_STATUS 0x03 /**< bit per touched channel */
+#define PI_HAT_CAP1166_LED_POLARITY 0x73 /**< LED output polarity */
+#define PI_HAT_CAP1166_LED_OUTPUT 0x74   /**< LED output control */
+
+#ifndef PI_HAT_I2C_DEVICE
+#define PI_HAT_I2C_DEVICE "/dev/i2c-1" /**< default bus of the Pi hat */
+#endif
+
+/**
+ * @brief the i2c bus
+ */
+typedef struct pi_hat_i2c_t pi_hat_i2c_t;
+
+/**
+ * @brief open the i2c bus
+ * the environment variable PI_HAT_I2C overrides the device
+ *
+ * @param device the i2c device (e.g. /dev/i2c-1) or PI_HAT_I2C_MOCK
+ * @return the bus, NULL on error
+ */
+pi_hat_i2c_t *pi_hat_i2c_open(const char *device);
+
+/**
+ * @brief close the i2c bus
+ *
+ * @param bus the bus
+ */
+void pi_hat_i2c_close(pi_hat_i2c_t *bus);
+
+/**
+ * @brief write registers of a chip
+ *
+ * @param bus the bus
+ * @param address the 7 bit i2c address of the chip
+ * @param reg the first register
+ * @param data the register values
+ * @param len the number of registers to write (max 32)
+ * @return int 0 == success
+ */
+int pi_hat_i2c_write(pi_hat_i2c_t *bus, uint8_t address, uint8_t reg,
+                     const uint8_t *data, size_t len);
+
+/**
+ * @brief read a register of a chip
+ *
+ * @param bus the bus
+ * @param address the 7 bit i2c address of the chip
+ * @param reg the register
+ * @param value the register value (output)
+ * @return int 0 == success
+ */
+int pi_hat_i2c_read(pi_hat_i2c_t *bus, uint8_t address, uint8_t reg,
+                    uint8_t *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_PI_HAT_I2C_H */
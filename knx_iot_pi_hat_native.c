@@ -0,0 +1,165 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * Pi hat backend without Python: i2c to the SN3218 and CAP1166
+ *
+ * The SN3218 drives the (RGB) backlight, the CAP1166 handles the touch
+ * buttons and drives the graph LEDs. The touch thread polls the interrupt
+ * bit of the CAP1166 and calls the touch callback for each new touch.
+ * The LCD itself is not driven: the host name is printed on stdout instead.
+ */
+#include "knx_iot_pi_hat_backend.h"
+#include "knx_iot_pi_hat_i2c.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PI_HAT_TOUCH_POLL_MS 50 /**< poll interval of the touch thread */
+#define PI_HAT_IDLE_BL 128      /**< backlight of the push button (idle) */
+
+static pi_hat_i2c_t *g_bus = NULL;          /**< the i2c bus */
+static pi_hat_touch_cb_t g_touch_cb = NULL; /**< touch button callback */
+static pthread_t g_touch_thread;            /**< polls the touch controller */
+static uint8_t g_led_output = 0;            /**< the graph LEDs (output thread) */
+
+/**
+ * @brief the touch button per CAP1166 input channel
+ */
+static const pi_hat_button_t g_channel_button[PI_HAT_BUTTONS] = {
+  PI_HAT_CANCEL, PI_HAT_UP, PI_HAT_DOWN, PI_HAT_LEFT, PI_HAT_RIGHT, PI_HAT_MID
+};
+
+/**
+ * @brief set all channels of the backlight to the same value
+ */
+static void
+pi_hat_backlight(uint8_t value)
+{
+  uint8_t pwm[PI_HAT_SN3218_CHANNELS];
+  uint8_t update = 0xFF;
+
+  memset(pwm, value, sizeof(pwm));
+  pi_hat_i2c_write(g_bus, PI_HAT_SN3218_ADDRESS, PI_HAT_SN3218_PWM, pwm,
+                   sizeof(pwm));
+  pi_hat_i2c_write(g_bus, PI_HAT_SN3218_ADDRESS, PI_HAT_SN3218_UPDATE,
+                   &update, 1);
+}
+
+/**
+ * @brief the touch thread: polls the interrupt of the touch controller
+ * a touch is reported once, on the interrupt of the new input
+ */
+static void *
+pi_hat_touch_thread(void *data)
+{
+  const struct timespec interval = { 0, PI_HAT_TOUCH_POLL_MS * 1000000L };
+  uint8_t control;
+  uint8_t status;
+  uint8_t touched = 0;
+  int channel;
+  (void)data;
+
+  while (1) {
+    nanosleep(&interval, NULL);
+    if (pi_hat_i2c_read(g_bus, PI_HAT_CAP1166_ADDRESS,
+                        PI_HAT_CAP1166_MAIN_CONTROL, &control) != 0 ||
+        (control & PI_HAT_CAP1166_INT) == 0) {
+      touched = 0;
+      continue;
+    }
+    pi_hat_i2c_read(g_bus, PI_HAT_CAP1166_ADDRESS,
+                    PI_HAT_CAP1166_INPUT_STATUS, &status);
+    // clear the interrupt, so that the next touch is reported
+    control &= (uint8_t)~PI_HAT_CAP1166_INT;
+    pi_hat_i2c_write(g_bus, PI_HAT_CAP1166_ADDRESS,
+                     PI_HAT_CAP1166_MAIN_CONTROL, &control, 1);
+
+    for (channel = 0; channel < PI_HAT_BUTTONS; channel++) {
+      if ((status & ~touched) & (1u << channel)) {
+        g_touch_cb(g_channel_button[channel]);
+      }
+    }
+    touched = status;
+  }
+  return NULL;
+}
+
+int
+pi_hat_backend_init(const char *init_function, pi_hat_touch_cb_t touch_cb)
+{
+  const uint8_t normal = 0x01;
+  const uint8_t enable[3] = { 0x3F, 0x3F, 0x3F };
+  const uint8_t off = 0x00;
+  char host[64];
+
+  g_bus = pi_hat_i2c_open(PI_HAT_I2C_DEVICE);
+  if (g_bus == NULL) {
+    fprintf(stderr, "pi_hat: no i2c bus\n");
+    return -1;
+  }
+
+  // backlight: on, all channels enabled
+  pi_hat_i2c_write(g_bus, PI_HAT_SN3218_ADDRESS, PI_HAT_SN3218_SHUTDOWN,
+                   &normal, 1);
+  pi_hat_i2c_write(g_bus, PI_HAT_SN3218_ADDRESS, PI_HAT_SN3218_ENABLE, enable,
+                   sizeof(enable));
+  // the push button ("init_client") has an idle backlight
+  pi_hat_backlight(strcmp(init_function, "init_client") == 0 ? PI_HAT_IDLE_BL
+                                                             : 0);
+
+  // turn off the blinding bright LEDS to the left of the screen
+  pi_hat_i2c_write(g_bus, PI_HAT_CAP1166_ADDRESS, PI_HAT_CAP1166_LED_POLARITY,
+                   &off, 1);
+  pi_hat_i2c_write(g_bus, PI_HAT_CAP1166_ADDRESS, PI_HAT_CAP1166_LED_OUTPUT,
+                   &off, 1);
+
+  if (gethostname(host, sizeof(host)) == 0) {
+    host[sizeof(host) - 1] = '\0';
+    printf("pi_hat: %s\n", host);
+  }
+
+  g_touch_cb = touch_cb;
+  if (g_touch_cb != NULL &&
+      pthread_create(&g_touch_thread, NULL, pi_hat_touch_thread, NULL) != 0) {
+    fprintf(stderr, "pi_hat: can't start the touch thread\n");
+    return -1;
+  }
+  return 0;
+}
+
+void
+pi_hat_backend_set_backlight(bool value)
+{
+  printf("Set backlight to %s\n", value ? "True" : "False");
+  pi_hat_backlight(value ? 0xFF : 0x00);
+}
+
+void
+pi_hat_backend_set_leds(uint32_t mask, uint32_t values)
+{
+  // the graph LEDs are the LED outputs of the touch controller
+  g_led_output = (uint8_t)((g_led_output & ~mask) | (values & mask));
+  pi_hat_i2c_write(g_bus, PI_HAT_CAP1166_ADDRESS, PI_HAT_CAP1166_LED_OUTPUT,
+                   &g_led_output, 1);
+}
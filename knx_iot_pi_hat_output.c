@@ -0,0 +1,176 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * Pi hat output thread: the writes to the hat are done off the main loop
+ *
+ * The main loop (producer) puts the LED and backlight changes in a single
+ * producer / single consumer ring, without locks. pi_hat_flush wakes up the
+ * output thread (consumer), which takes all queued changes, keeps the last
+ * state per LED and writes the result with one backend call.
+ * When the ring is full (the hat is slower than the changes) the change is
+ * not queued: the output thread then writes the latest state of all outputs,
+ * which the producer keeps next to the ring.
+ */
+#include "knx_iot_pi_hat.h"
+#include "knx_iot_pi_hat_backend.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+
+#define PI_HAT_QUEUE_SIZE 64 /**< entries in the ring, power of 2 */
+#define PI_HAT_BACKLIGHT PI_HAT_MAX_LEDS /**< output number of the backlight */
+#define PI_HAT_VALUE 0x80    /**< entry: the new state of the output */
+#define PI_HAT_LED_MASK ((1u << PI_HAT_MAX_LEDS) - 1) /**< all LEDs */
+
+static uint8_t g_ring[PI_HAT_QUEUE_SIZE]; /**< output number | PI_HAT_VALUE */
+static uint32_t g_head = 0;    /**< next entry to write (producer) */
+static uint32_t g_tail = 0;    /**< next entry to read (consumer) */
+static uint32_t g_flushed = 0; /**< g_head at the last flush (producer) */
+static bool g_overflow = false;     /**< changes were not queued */
+static uint32_t g_shadow_set = 0;   /**< bit per output ever set */
+static uint32_t g_shadow_value = 0; /**< bit per output: the latest state */
+
+static sem_t g_sem;              /**< flushes, wakes up the output thread */
+static pthread_t g_output_thread; /**< writes to the hat */
+
+/**
+ * @brief queue a change of an output (main loop)
+ *
+ * @param output the LED number or PI_HAT_BACKLIGHT
+ * @param value the new state
+ */
+static void
+pi_hat_queue(int output, bool value)
+{
+  uint32_t head = g_head;
+  uint32_t tail = __atomic_load_n(&g_tail, __ATOMIC_ACQUIRE);
+
+  // the latest state, used by the output thread after an overflow
+  __atomic_fetch_or(&g_shadow_set, 1u << output, __ATOMIC_RELAXED);
+  if (value) {
+    __atomic_fetch_or(&g_shadow_value, 1u << output, __ATOMIC_RELEASE);
+  } else {
+    __atomic_fetch_and(&g_shadow_value, ~(1u << output), __ATOMIC_RELEASE);
+  }
+
+  if (head - tail == PI_HAT_QUEUE_SIZE) {
+    __atomic_store_n(&g_overflow, true, __ATOMIC_RELEASE);
+    return;
+  }
+  g_ring[head & (PI_HAT_QUEUE_SIZE - 1)] =
+    (uint8_t)(output | (value ? PI_HAT_VALUE : 0));
+  __atomic_store_n(&g_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief the output thread: writes the queued changes to the hat
+ */
+static void *
+pi_hat_output_thread(void *data)
+{
+  uint32_t head;
+  uint32_t tail;
+  uint32_t mask;
+  uint32_t value;
+  uint8_t entry;
+  (void)data;
+
+  while (1) {
+    while (sem_wait(&g_sem) != 0 && errno == EINTR) {
+    }
+    // all pending flushes are handled by this pass
+    while (sem_trywait(&g_sem) == 0) {
+    }
+
+    mask = 0;
+    value = 0;
+    tail = g_tail;
+    head = __atomic_load_n(&g_head, __ATOMIC_ACQUIRE);
+    while (tail != head) {
+      entry = g_ring[tail & (PI_HAT_QUEUE_SIZE - 1)];
+      tail++;
+      // coalesce: only the last state of an output is written
+      mask |= 1u << (entry & ~PI_HAT_VALUE);
+      if (entry & PI_HAT_VALUE) {
+        value |= 1u << (entry & ~PI_HAT_VALUE);
+      } else {
+        value &= ~(1u << (entry & ~PI_HAT_VALUE));
+      }
+    }
+    __atomic_store_n(&g_tail, tail, __ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n(&g_overflow, false, __ATOMIC_ACQ_REL)) {
+      mask = __atomic_load_n(&g_shadow_set, __ATOMIC_RELAXED);
+      value = __atomic_load_n(&g_shadow_value, __ATOMIC_ACQUIRE);
+    }
+
+    if (mask & (1u << PI_HAT_BACKLIGHT)) {
+      pi_hat_backend_set_backlight((value & (1u << PI_HAT_BACKLIGHT)) != 0);
+    }
+    if (mask & PI_HAT_LED_MASK) {
+      pi_hat_backend_set_leds(mask & PI_HAT_LED_MASK, value & PI_HAT_LED_MASK);
+    }
+  }
+  return NULL;
+}
+
+int
+pi_hat_init(const char *init_function, pi_hat_touch_cb_t touch_cb)
+{
+  if (pi_hat_backend_init(init_function, touch_cb) != 0) {
+    return -1;
+  }
+  if (sem_init(&g_sem, 0, 0) != 0 ||
+      pthread_create(&g_output_thread, NULL, pi_hat_output_thread, NULL) !=
+        0) {
+    fprintf(stderr, "pi_hat: can't start the output thread\n");
+    return -1;
+  }
+  return 0;
+}
+
+void
+pi_hat_set_backlight(bool value)
+{
+  pi_hat_queue(PI_HAT_BACKLIGHT, value);
+}
+
+void
+pi_hat_set_led(int led_nr, bool value)
+{
+  if (led_nr < 0 || led_nr >= PI_HAT_MAX_LEDS) {
+    return;
+  }
+  pi_hat_queue(led_nr, value);
+}
+
+void
+pi_hat_flush(void)
+{
+  if (g_head == g_flushed &&
+      __atomic_load_n(&g_overflow, __ATOMIC_ACQUIRE) == false) {
+    return;
+  }
+  g_flushed = g_head;
+  sem_post(&g_sem);
+}
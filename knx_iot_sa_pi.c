@@ -17,142 +17,174 @@
 */
 
 #include "knx_iot_virtual_sa.h"
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_journal.h"
+#include "knx_iot_virtual_swu.h"
+#include "knx_iot_virtual_got.h"
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_pi_hat.h"
 #include "api/oc_knx_dev.h"
 #include "api/oc_knx_fp.h"
 
 
-#include <Python.h>
 #include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
 
 static volatile int quit = 0; /**< stop variable, used by handle_signal */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
 static struct timespec ts;
-// Python objects used for initialization
-PyObject *pModule;
-
-// Python function for turning the backlight of the LCD on or off.
-// Takes one boolean argument matching the desired state of the backlight
-PyObject *pSetBacklightFunc;
-PyObject *pSetLedFunc;
-
-void
-python_binding_init(void)
+static bool g_wakeup = false; /**< event loop signalled, protected by mutex */
+static int g_signal_pipe[2] = { -1, -1 }; /**< Ctrl-C to the signal thread */
+/**
+ * @brief wakes up the main loop
+ * called by signal_event_loop
+ */
+static void
+wakeup_main_loop(void)
 {
-  Py_Initialize();
-
-  // Import the Python module that talks to the Displayotron HAT
-  PyObject *pName = PyUnicode_DecodeFSDefault("pi_hat");
-
-  // Add current directory to Python path, so that we may import the module
-  // located in the same folder as the executable
-  PyRun_SimpleString("import sys");
-  PyRun_SimpleString("import os");
-  PyRun_SimpleString("sys.path.append(os.getcwd())");
-
-  pModule = PyImport_Import(pName);
-  Py_DECREF(pName);
-
-  if (pModule) {
-    // Import the test function, to check the import is successful
-    // & that we are importing the right script
-    PyObject *pPrintInPythonFunc =
-      PyObject_GetAttrString(pModule, "print_in_python");
+  pthread_mutex_lock(&mutex);
+  g_wakeup = true;
+  pthread_cond_signal(&cv);
+  pthread_mutex_unlock(&mutex);
+}
 
-    if (pPrintInPythonFunc && PyCallable_Check(pPrintInPythonFunc)) {
-      // Ensure that the Python embedding is successful
-      PyObject *pValue = PyObject_CallObject(pPrintInPythonFunc, NULL);
+/**
+ * @brief wait until the next event of the stack, or until woken up
+ *
+ * @param next_event the time of the next event, 0 == no event scheduled
+ */
+static void
+wait_main_loop(oc_clock_time_t next_event)
+{
+  pthread_mutex_lock(&mutex);
+  if (g_wakeup == false) {
+    if (next_event == 0) {
+      pthread_cond_wait(&cv, &mutex);
+    } else {
+      ts.tv_sec = (next_event / OC_CLOCK_SECOND);
+      ts.tv_nsec = (next_event % OC_CLOCK_SECOND) * 1.e09 / OC_CLOCK_SECOND;
+      pthread_cond_timedwait(&cv, &mutex, &ts);
     }
-    // Do not need the test function anymore, so we decrement the reference
-    // counter so that the memory for this object can be garbage-collected
-    Py_DECREF(pPrintInPythonFunc);
-
-    // Import the rest of the Python API
-    pSetBacklightFunc = PyObject_GetAttrString(pModule, "set_backlight");
-    pSetLedFunc = PyObject_GetAttrString(pModule, "set_led");
-
-    // Initialize the state of the LCD
-    PyRun_SimpleString("import pi_hat");
-    PyRun_SimpleString("pi_hat.init()");
-
-  } else {
-    PyErr_Print();
-    fprintf(stderr, "Failed to load pi_hat\n");
-    fprintf(stderr, "Please ensure that pi_hat.py is in the directory "
-                    "you are running this executable from!\n");
-    exit(1);
   }
+  g_wakeup = false;
+  pthread_mutex_unlock(&mutex);
 }
 
-void
-set_backlight(bool value)
+/**
+ * the LED of the graph per data point, other 2 not yet mapped
+ */
+static const struct
+{
+  const char *url;
+  int led;
+} g_led_dp[] = { { "/p/o_1_1", 1 }, { "/p/o_3_3", 2 },
+                 { "/p/o_5_5", 3 }, { "/p/o_7_7", 4 } };
+
+/**
+ * @brief shows the value of a data point on its LED
+ * subscribed per data point (the LED number is the user data)
+ */
+static void
+led_callback(const app_notify_event_t *events, int count, void *user_data)
 {
-  if (pSetBacklightFunc && PyCallable_Check(pSetBacklightFunc)) {
-    // When called from C, Python functions expect a single tuple argument
-    // containing the arguments defined in the API
-    PyObject *pArgs = PyTuple_New(1);
-    PyObject *pArgTheZeroth = PyBool_FromLong(value);
-    PyTuple_SetItem(pArgs, 0, pArgTheZeroth);
-
-    PyObject *pReturn = PyObject_Call(pSetBacklightFunc, pArgs, NULL);
-    PyErr_Print();
-
-    // cleanup - must free every temporary Python object
-    Py_DECREF(pArgs);
-    Py_DECREF(pArgTheZeroth);
-    Py_DECREF(pReturn);
-  } else {
-    PyErr_Print();
-    fprintf(stderr, "set_backlight was not called successfully!");
+  int led = (int)(intptr_t)user_data;
+  for (int i = 0; i < count; i++) {
+    if (events[i].device == 0) {
+      pi_hat_set_led(led, events[i].new_value);
+    }
   }
 }
 
-
-void
-set_led(int led_nr, bool value)
+/**
+ * @brief subscribe the LEDs to their data points
+ * called after the data point registry is initialized (app_initialize_stack)
+ * the LEDs show the current values first: the values restored from the
+ * journal do not cause a notification
+ */
+static void
+subscribe_leds(void)
 {
-  if (pSetLedFunc && PyCallable_Check(pSetLedFunc)) {
-    // When called from C, Python functions expect a single tuple argument
-    // containing the arguments defined in the API
-    PyObject *pArgs = PyTuple_New(2);
-    PyObject *pArgTheZeroth = PyLong_FromLong(led_nr);
-    PyObject *pArgTheFirst = PyBool_FromLong(value);
-    PyTuple_SetItem(pArgs, 0, pArgTheZeroth);
-    PyTuple_SetItem(pArgs, 1, pArgTheFirst);
-
-    PyObject *pReturn = PyObject_Call(pSetLedFunc, pArgs, NULL);
-    PyErr_Print();
-
-    // cleanup - must free every temporary Python object
-    Py_DECREF(pArgs);
-    Py_DECREF(pArgTheZeroth);
-    Py_DECREF(pArgTheFirst);
-    Py_DECREF(pReturn);
-  } else {
-    PyErr_Print();
-    fprintf(stderr, "set_led was not called successfully!");
+  size_t i;
+  for (i = 0; i < sizeof(g_led_dp) / sizeof(g_led_dp[0]); i++) {
+    app_notify_subscribe_url(g_led_dp[i].url, 0, led_callback,
+                             (void *)(intptr_t)g_led_dp[i].led);
+    pi_hat_set_led(g_led_dp[i].led,
+                   app_retrieve_bool_variable((char *)g_led_dp[i].url));
   }
 }
 
-void put_callback(char* url){
-  bool my_bool = app_retrieve_bool_variable(url);
-  if (strcmp(url, "/p/o_1_1") == 0) set_led(1, my_bool);
-  if (strcmp(url, "/p/o_3_3") == 0) set_led(2, my_bool);
-  if (strcmp(url, "/p/o_5_5") == 0) set_led(3, my_bool);
-  if (strcmp(url, "/p/o_7_7") == 0) set_led(4, my_bool);
-  // other 2 not yet mapped
-}
 
+/**
+ * @brief dump the trace ring and the stats on stdout (SIGUSR1)
+ * @param signal the captured signal
+ */
+static void
+handle_trace_signal(int signal)
+{
+  (void)signal;
+  app_trace_dump_fd(STDOUT_FILENO);
+  app_stats_dump_fd(STDOUT_FILENO);
+}
 
 /**
  * @brief handle Ctrl-C
+ * the main loop is woken up by the signal thread: a signal handler can't
+ * use the mutex, writing to the pipe is async-signal-safe
  * @param signal the captured signal
  */
 static void
 handle_signal(int signal)
 {
+  int saved_errno = errno;
   (void)signal;
-  //signal_event_loop();
   quit = 1;
+  if (g_signal_pipe[1] >= 0) {
+    ssize_t ret = write(g_signal_pipe[1], "q", 1);
+    (void)ret;
+  }
+  errno = saved_errno;
+}
+
+/**
+ * @brief the signal thread: wakes up the main loop after Ctrl-C
+ */
+static void *
+signal_thread(void *data)
+{
+  char c;
+  (void)data;
+  while (read(g_signal_pipe[0], &c, 1) < 0 && errno == EINTR) {
+  }
+  wakeup_main_loop();
+  return NULL;
+}
+
+/**
+ * @brief start the signal thread, before installing handle_signal
+ * @return int 0 == success
+ */
+static int
+start_signal_thread(void)
+{
+  pthread_t thread;
+  if (pipe(g_signal_pipe) != 0) {
+    return -1;
+  }
+  if (pthread_create(&thread, NULL, signal_thread, NULL) != 0) {
+    close(g_signal_pipe[0]);
+    close(g_signal_pipe[1]);
+    g_signal_pipe[0] = g_signal_pipe[1] = -1;
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
 }
 
 /**
@@ -169,34 +201,52 @@ main(void)
   oc_clock_time_t next_event;
 
   /* Linux specific */
+  if (start_signal_thread() != 0) {
+    fprintf(stderr, "can't start the signal thread\n");
+    exit(1);
+  }
   struct sigaction sa;
   sigfillset(&sa.sa_mask);
   sa.sa_flags = 0;
   sa.sa_handler = handle_signal;
   /* install Ctrl-C */
   sigaction(SIGINT, &sa, NULL);
+  /* kill -USR1 dumps the trace ring */
+  sa.sa_handler = handle_trace_signal;
+  sigaction(SIGUSR1, &sa, NULL);
   /* Disable full buffering so stdout appears in journalctl */
   setvbuf(stdout, NULL, _IONBF, BUFSIZ);
 
-  app_set_put_cb(put_callback);
+  app_set_wakeup_cb(wakeup_main_loop);
 
   app_initialize_stack();
+  // the LEDs show the switch data points
+  subscribe_leds();
 
-  // Start the embedded Python interpreter and initialize the Python API
+  // Initialize the Pi hat (no touch input on the actuator)
   // Necessary for controlling the backlight
-  python_binding_init();
+  if (pi_hat_init("init", NULL) != 0) {
+    exit(1);
+  }
   // Set the backlight to the initial value
-  // set_backlight(g_mystate);
-
-  set_backlight(true);
+  pi_hat_set_backlight(true);
 
-  /* Linux specific loop */
+  /* Linux specific loop
+     the writes to the Pi hat are done by its output thread */
   while (quit != 1) {
-    oc_main_poll();
+    next_event = oc_main_poll();
+    // the tables can be rewritten while loading
+    app_got_check_load_state();
+    app_meta_check_load_state();
+    // hand the LEDs changed during the poll to the output thread
+    pi_hat_flush();
+    wait_main_loop(next_event);
   }
 
   /* shut down the stack */
 
   oc_main_shutdown();
+  app_swu_shutdown();
+  app_journal_close();
   return 0;
 }
@@ -0,0 +1,242 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * switch latency benchmark support
+ *
+ * The log is written with stdio and a large buffer: the notify callback
+ * runs in the PUT handler and only formats the line.
+ * The timer thread sleeps until the absolute time of the next press, so
+ * the rate does not drift with the time spent in the main loop. It puts the
+ * scheduled time of each press in a ring (single producer, single consumer)
+ * and the press is logged with that time, so the time the press waits for
+ * the main loop is part of the measured latency.
+ * A data point is pressed at most once per poll: the s-mode messages of one
+ * poll are sent once per data point, a second press would be merged with the
+ * first one.
+ */
+#ifdef __linux__
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "knx_iot_virtual_bench.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_shard.h"
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_state.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#define APP_BENCH_LOG_BUFFER (256 * 1024) /**< stdio buffer of the log */
+#define APP_BENCH_RING 4096 /**< max presses due (power of 2) */
+
+static FILE *g_bench_log = NULL;    /**< the event log */
+static int g_bench_log_handle = -1; /**< the notify subscription */
+
+static int g_bench_ids[APP_BENCH_MAX_URLS]; /**< the data points to toggle */
+static int g_bench_count = 0;       /**< the number of data points, 0 == off */
+static int g_bench_next = 0;        /**< the next data point to toggle */
+static uint64_t g_bench_press_ns = 0; /**< scheduled time of the press being
+                                           published, 0 == no press */
+
+#ifdef __linux__
+static pthread_t g_bench_thread;       /**< the timer thread */
+static uint64_t g_bench_period_ns = 0; /**< time between the presses */
+static void (*g_bench_wakeup)(void) = NULL; /**< wakes up the main loop */
+static uint64_t g_bench_due[APP_BENCH_RING]; /**< scheduled press times */
+static uint32_t g_bench_head = 0;    /**< next press (timer thread) */
+static uint32_t g_bench_tail = 0;    /**< next press handled (main loop) */
+static uint32_t g_bench_dropped = 0; /**< presses dropped, the ring is full */
+#endif /* __linux__ */
+
+/**
+ * @brief write the events to the log (notify callback)
+ */
+static void
+app_bench_log_cb(const app_notify_event_t *events, int count, void *user_data)
+{
+  uint64_t now = app_shard_time_ns();
+  int i;
+  (void)user_data;
+
+  for (i = 0; i < count; i++) {
+    uint64_t time = (events[i].source == APP_NOTIFY_LOCAL &&
+                     g_bench_press_ns != 0)
+                      ? g_bench_press_ns
+                      : now;
+    fprintf(g_bench_log, "%" PRIu64 " %u %s %d %d\n", time,
+            (unsigned)events[i].device, app_dp_get(events[i].id)->url,
+            events[i].new_value ? 1 : 0, (int)events[i].source);
+  }
+}
+
+int
+app_bench_log_open(const char *path)
+{
+  g_bench_log = fopen(path, "w");
+  if (g_bench_log == NULL) {
+    fprintf(stderr, "bench: can't open %s\n", path);
+    return -1;
+  }
+  setvbuf(g_bench_log, NULL, _IOFBF, APP_BENCH_LOG_BUFFER);
+  g_bench_log_handle =
+    app_notify_subscribe(APP_NOTIFY_ALL, 0, app_bench_log_cb, NULL);
+  if (g_bench_log_handle < 0) {
+    fclose(g_bench_log);
+    g_bench_log = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+void
+app_bench_log_close(void)
+{
+  if (g_bench_log == NULL) {
+    return;
+  }
+#ifdef __linux__
+  if (g_bench_dropped > 0) {
+    fprintf(stderr, "bench: %u presses dropped, the main loop was too slow\n",
+            (unsigned)g_bench_dropped);
+  }
+#endif /* __linux__ */
+  app_notify_unsubscribe(g_bench_log_handle);
+  g_bench_log_handle = -1;
+  fclose(g_bench_log);
+  g_bench_log = NULL;
+}
+
+#ifdef __linux__
+/**
+ * @brief the timer thread: a press per period
+ */
+static void *
+app_bench_thread(void *data)
+{
+  struct timespec next;
+  uint32_t head;
+  (void)data;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while (1) {
+    next.tv_nsec += (long)(g_bench_period_ns % 1000000000ULL);
+    next.tv_sec += (time_t)(g_bench_period_ns / 1000000000ULL);
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) !=
+           0) {
+    }
+    head = __atomic_load_n(&g_bench_head, __ATOMIC_RELAXED);
+    if (head - __atomic_load_n(&g_bench_tail, __ATOMIC_ACQUIRE) <
+        APP_BENCH_RING) {
+      g_bench_due[head % APP_BENCH_RING] =
+        (uint64_t)next.tv_sec * 1000000000ULL + (uint64_t)next.tv_nsec;
+      __atomic_store_n(&g_bench_head, head + 1, __ATOMIC_RELEASE);
+    } else {
+      __atomic_fetch_add(&g_bench_dropped, 1, __ATOMIC_RELAXED);
+    }
+    g_bench_wakeup();
+  }
+  return NULL;
+}
+#endif /* __linux__ */
+
+int
+app_bench_start(double rate, const char *const *urls, int count,
+                void (*wakeup)(void))
+{
+  int i;
+
+  if (rate <= 0 || count <= 0 || count > APP_BENCH_MAX_URLS ||
+      wakeup == NULL) {
+    return -1;
+  }
+  for (i = 0; i < count; i++) {
+    const app_dp_t *dp = app_dp_find(urls[i]);
+    if (dp == NULL) {
+      fprintf(stderr, "bench: unknown url %s\n", urls[i]);
+      return -1;
+    }
+    g_bench_ids[i] = app_dp_index(dp);
+  }
+#ifdef __linux__
+  g_bench_count = count;
+  g_bench_period_ns = (uint64_t)(1e9 / rate);
+  g_bench_wakeup = wakeup;
+  if (pthread_create(&g_bench_thread, NULL, app_bench_thread, NULL) != 0) {
+    fprintf(stderr, "bench: can't start the timer thread\n");
+    g_bench_count = 0;
+    return -1;
+  }
+  return 0;
+#else
+  fprintf(stderr, "bench: the toggle driver is only available on Linux\n");
+  return -1;
+#endif /* __linux__ */
+}
+
+uint32_t
+app_bench_pending(void)
+{
+#ifdef __linux__
+  return __atomic_load_n(&g_bench_head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&g_bench_tail, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif /* __linux__ */
+}
+
+void
+app_bench_poll(void)
+{
+#ifdef __linux__
+  uint32_t tail = g_bench_tail;
+  uint32_t head;
+  uint32_t pressed = 0;
+  app_state_t *state;
+  bool value;
+  int id;
+
+  if (g_bench_count == 0) {
+    return;
+  }
+  head = __atomic_load_n(&g_bench_head, __ATOMIC_ACQUIRE);
+  state = app_state_store(0);
+  /* once per data point: the next press waits for the next poll */
+  while (tail != head && (pressed & (1u << g_bench_next)) == 0) {
+    pressed |= 1u << g_bench_next;
+    id = g_bench_ids[g_bench_next];
+    g_bench_next = (g_bench_next + 1) % g_bench_count;
+    g_bench_press_ns = g_bench_due[tail % APP_BENCH_RING];
+    value = app_state_toggle(state, id);
+    app_notify_publish(0, id, !value, value, APP_NOTIFY_LOCAL);
+    app_smode_queue(id, app_smode_scopes());
+    tail++;
+  }
+  g_bench_press_ns = 0;
+  __atomic_store_n(&g_bench_tail, tail, __ATOMIC_RELEASE);
+#endif /* __linux__ */
+}
@@ -0,0 +1,98 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * switch latency benchmark support, shared by the virtual applications.
+ *
+ * The event log writes a line per data point change (PUT or local toggle)
+ * with the monotonic time in nanoseconds:
+ *   <time ns> <device> <url> <value> <source>
+ * so that the logs of the push button and the switch actuator on the same
+ * host can be matched (bench_switch_latency.py): press on the push button,
+ * PUT on OnOff_N of the actuator, PUT on InfoOnOff_N of the push button.
+ * The toggle driver presses the push buttons at a fixed rate: a timer
+ * thread records the scheduled time of each press and wakes up the main
+ * loop, the main loop toggles the data points (app_bench_poll) and sends
+ * them with s-mode, as the buttons of the GUI do. A press is logged with
+ * its scheduled time.
+ * The driver is only available on Linux.
+ */
+#ifndef KNX_IOT_VIRTUAL_BENCH_H
+#define KNX_IOT_VIRTUAL_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_BENCH_MAX_URLS 8 /**< max data points toggled by the driver */
+
+/**
+ * @brief open the event log
+ * subscribes to all data points, call after the data point registry is
+ * initialized
+ *
+ * @param path the file name of the log
+ * @return int 0 == success
+ */
+int app_bench_log_open(const char *path);
+
+/**
+ * @brief flush and close the event log
+ */
+void app_bench_log_close(void);
+
+/**
+ * @brief start the toggle driver
+ * the data points are toggled round robin, one per press
+ *
+ * @param rate the presses per second
+ * @param urls the urls of the data points to toggle
+ * @param count the number of urls
+ * @param wakeup wakes up the main loop (e.g. signal_event_loop)
+ * @return int 0 == success
+ */
+int app_bench_start(double rate, const char *const *urls, int count,
+                    void (*wakeup)(void));
+
+/**
+ * @brief presses that are due and not yet handled
+ * the main loop does not wait when presses are pending
+ *
+ * @return the number of pending presses
+ */
+uint32_t app_bench_pending(void);
+
+/**
+ * @brief handle the pending presses (main loop, before oc_main_poll)
+ * each press toggles the data point, publishes the change
+ * (APP_NOTIFY_LOCAL) and queues the s-mode message.
+ * A data point is pressed at most once per call, so each press is sent in
+ * its own s-mode message: the other presses stay pending.
+ */
+void app_bench_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_BENCH_H */
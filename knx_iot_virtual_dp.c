@@ -0,0 +1,429 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * data point registry
+ *
+ * The url index is an open addressing hash table (linear probing).
+ * Each slot stores the full hash of the url, so that a lookup only does a
+ * string compare on the slot that has the same hash.
+ * The table is sized at twice APP_DP_MAX, so the probe sequences are short.
+ *
+ * The generic GET/PUT handlers get the descriptor as user data, so no
+ * per data point code is needed.
+ */
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_state.h"
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_shard.h"
+
+#include "oc_api.h"
+#include "oc_rep.h"
+
+#include <string.h>
+
+/* the handlers record trace events (knx_iot_virtual_trace.h), printing per
+   request is only done with APP_DP_VERBOSE */
+#ifdef APP_DP_VERBOSE
+#define APP_DP_PRINT(...) PRINT(__VA_ARGS__)
+#else
+#define APP_DP_PRINT(...)
+#endif
+
+#define APP_DP_HASH_SIZE (2 * APP_DP_MAX) /**< must be a power of 2 */
+#define APP_DP_HASH_MASK (APP_DP_HASH_SIZE - 1)
+
+/**
+ * @brief slot of the url index
+ */
+typedef struct app_dp_slot_t
+{
+  uint32_t hash; /**< hash of the url */
+  int16_t index; /**< index in the data point table, APP_DP_NONE == empty */
+} app_dp_slot_t;
+
+static const app_dp_t *g_dp_table = NULL; /**< the registered table */
+static int g_dp_count = 0;                /**< entries in the table */
+static app_dp_slot_t g_dp_slots[APP_DP_HASH_SIZE]; /**< the url index */
+static uint32_t g_dp_requests = 0; /**< GET/PUT requests handled */
+
+/**
+ * @brief the value payload { 1: value } of a boolean data point, pre-encoded
+ * as CBOR (map of 1 entry, key 1, false/true)
+ */
+static const uint8_t g_dp_bool_payload[2][3] = { { 0xA1, 0x01, 0xF4 },
+                                                 { 0xA1, 0x01, 0xF5 } };
+
+/**
+ * @brief FNV-1a hash of a (zero terminated) url
+ *
+ * @param url the url
+ * @return uint32_t the hash
+ */
+static uint32_t
+app_dp_hash(const char *url)
+{
+  uint32_t hash = 2166136261u;
+  while (*url != '\0') {
+    hash ^= (uint8_t)*url++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int
+app_dp_registry_init(const app_dp_t *table, int count)
+{
+  int i;
+
+  if (table == NULL || count < 0 || count > APP_DP_MAX) {
+    return -1;
+  }
+  for (i = 0; i < APP_DP_HASH_SIZE; i++) {
+    g_dp_slots[i].hash = 0;
+    g_dp_slots[i].index = APP_DP_NONE;
+  }
+  for (i = 0; i < count; i++) {
+    uint32_t hash = app_dp_hash(table[i].url);
+    uint32_t slot = hash & APP_DP_HASH_MASK;
+    while (g_dp_slots[slot].index != APP_DP_NONE) {
+      slot = (slot + 1) & APP_DP_HASH_MASK;
+    }
+    g_dp_slots[slot].hash = hash;
+    g_dp_slots[slot].index = (int16_t)i;
+  }
+  g_dp_table = table;
+  g_dp_count = count;
+  return 0;
+}
+
+const app_dp_t *
+app_dp_find(const char *url)
+{
+  uint32_t hash;
+  uint32_t slot;
+
+  if (url == NULL || g_dp_table == NULL) {
+    return NULL;
+  }
+  hash = app_dp_hash(url);
+  slot = hash & APP_DP_HASH_MASK;
+  while (g_dp_slots[slot].index != APP_DP_NONE) {
+    if (g_dp_slots[slot].hash == hash) {
+      const app_dp_t *dp = &g_dp_table[g_dp_slots[slot].index];
+      if (strcmp(dp->url, url) == 0) {
+        return dp;
+      }
+    }
+    slot = (slot + 1) & APP_DP_HASH_MASK;
+  }
+  return NULL;
+}
+
+const app_dp_t *
+app_dp_get(int index)
+{
+  if (g_dp_table == NULL || index < 0 || index >= g_dp_count) {
+    return NULL;
+  }
+  return &g_dp_table[index];
+}
+
+int
+app_dp_index(const app_dp_t *dp)
+{
+  if (dp == NULL || g_dp_table == NULL) {
+    return APP_DP_NONE;
+  }
+  return (int)(dp - g_dp_table);
+}
+
+int
+app_dp_count(void)
+{
+  return g_dp_count;
+}
+
+int
+app_dp_encode_value(const app_dp_t *dp, bool value)
+{
+  switch (dp->type) {
+  case APP_DP_BOOL:
+    oc_rep_encode_raw(g_dp_bool_payload[value ? 1 : 0],
+                      sizeof(g_dp_bool_payload[0]));
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+uint32_t
+app_dp_request_count(void)
+{
+  return g_dp_requests;
+}
+
+/**
+ * @brief handle a GET on a data point
+ *
+ * @return the response code sent
+ */
+static oc_status_t
+app_dp_handle_get(oc_request_t *request, const app_dp_t *dp)
+{
+  bool error_state = false;
+
+  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
+     sensor. the call to the HW needs to fill in the value slot before it
+     returns to this function here. alternative is to have a callback from the
+     hardware that sets the value.
+  */
+  APP_DP_PRINT("-- Begin get %s %s \n", dp->name, dp->url);
+  /* check if the accept header is CBOR */
+  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
+    oc_send_response(request, OC_STATUS_BAD_OPTION);
+    return OC_STATUS_BAD_OPTION;
+  }
+
+  // check the query parameter m with the various values
+  char *m;
+  char *m_key;
+  size_t m_key_len;
+  int m_query_len = oc_get_query_value(request, "m", &m);
+  if (m_query_len != -1) {
+    size_t m_len = (size_t)m_query_len;
+    APP_DP_PRINT("  Query param: %.*s\n", (int)m_len, m);
+    oc_init_query_iterator();
+    uint8_t fields = 0;
+    while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
+      if (m_key_len == 1 && m_key[0] == 'm') {
+        fields |= app_meta_parse_fields(m, m_len);
+      }
+    }
+    oc_rep_begin_root_object();
+    if (app_meta_encode(dp, request->resource->device, fields) != 0) {
+      /* device is NULL */
+      oc_send_response(request, OC_STATUS_BAD_OPTION);
+      return OC_STATUS_BAD_OPTION;
+    }
+    oc_rep_end_root_object();
+    oc_send_cbor_response(request, OC_STATUS_OK);
+    return OC_STATUS_OK;
+  }
+  app_state_t *state = app_state_store(request->resource->device);
+  if (state == NULL) {
+    oc_send_response(request, OC_STATUS_INTERNAL_SERVER_ERROR);
+    return OC_STATUS_INTERNAL_SERVER_ERROR;
+  }
+  if (app_dp_encode_value(dp, app_state_get(state, app_dp_index(dp))) != 0) {
+    error_state = true;
+  }
+  APP_DP_PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
+  APP_DP_PRINT("-- End get %s\n", dp->name);
+  if (error_state == false) {
+    oc_send_cbor_response(request, OC_STATUS_OK);
+    return OC_STATUS_OK;
+  }
+  oc_send_response(request, OC_STATUS_BAD_OPTION);
+  return OC_STATUS_BAD_OPTION;
+}
+
+/**
+ * @brief the data point of a request, resolved from the url of the resource
+ * the user data is not used: the stack also calls the handlers itself (s-mode
+ * write dispatch of /k, reading the value of an s-mode message) with its own
+ * user data or NULL.
+ *
+ * @return the data point, NULL if the resource is not a data point
+ */
+static const app_dp_t *
+app_dp_from_request(const oc_request_t *request)
+{
+  if (request == NULL || request->resource == NULL) {
+    return NULL;
+  }
+  return app_dp_find(oc_string(request->resource->uri));
+}
+
+void
+app_dp_get_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                   void *user_data)
+{
+  (void)interfaces;
+  (void)user_data;
+  const app_dp_t *dp = app_dp_from_request(request);
+  size_t device;
+  app_state_t *state;
+  int id;
+  uint64_t start = app_shard_time_ns();
+  oc_status_t status;
+
+  g_dp_requests++;
+  if (dp == NULL) {
+    oc_send_response(request, OC_STATUS_NOT_FOUND);
+    return;
+  }
+  device = request->resource->device;
+  state = app_state_store(device);
+  id = app_dp_index(dp);
+  status = app_dp_handle_get(request, dp);
+  app_stats_request(APP_STATS_GET, id, status, false,
+                    app_shard_time_ns() - start);
+  APP_TRACE(APP_TRACE_GET, device, id, (uint8_t)status,
+            (state != NULL) ? app_state_get(state, id) : 0);
+}
+
+/**
+ * @brief handle a PUT on a data point
+ *
+ * @return the response code sent
+ */
+static oc_status_t
+app_dp_handle_put(oc_request_t *request, const app_dp_t *dp)
+{
+  size_t device = request->resource->device;
+  app_state_t *state = app_state_store(device);
+  int id = app_dp_index(dp);
+  bool error_state = true;
+  bool old_value = false;
+  APP_DP_PRINT("-- Begin put %s:\n", dp->name);
+
+  if (state == NULL) {
+    oc_send_response(request, OC_STATUS_INTERNAL_SERVER_ERROR);
+    return OC_STATUS_INTERNAL_SERVER_ERROR;
+  }
+
+  /* handle the different requests e.g. via s-mode or normal CoAP call*/
+  if (oc_is_redirected_request(request)) {
+    APP_DP_PRINT("  redirected request..\n");
+  }
+  oc_rep_t *rep = request->request_payload;
+  /* loop over all the entries in the request */
+  while (rep != NULL) {
+    /* handle the type of payload correctly. */
+    if ((rep->iname == 1) && (rep->type == OC_REP_BOOL)) {
+      APP_DP_PRINT("  put %s received : %d\n", dp->name, rep->value.boolean);
+      old_value = app_state_set(state, id, rep->value.boolean);
+      error_state = false;
+      break;
+    }
+    rep = rep->next;
+  }
+
+  if (error_state == true) {
+    /* request data was not recognized, so it was a bad request */
+    oc_send_response(request, OC_STATUS_BAD_REQUEST);
+    APP_DP_PRINT("-- End put %s\n", dp->name);
+    return OC_STATUS_BAD_REQUEST;
+  }
+  oc_send_cbor_response(request, OC_STATUS_CHANGED);
+
+  const app_dp_t *info = app_dp_get(dp->feedback);
+  if (info != NULL) {
+    /* update the status information */
+    if (app_state_get_fault(state, id) == false) {
+      /* no fault hence update the feedback with the current state */
+      bool value = app_state_get(state, id);
+      APP_DP_PRINT("  No Fault update feedback to %d\n", value);
+      app_state_set(state, dp->feedback, value);
+    } else {
+      /* fault hence update the feedback with "false" */
+      APP_DP_PRINT("  Fault\n");
+      app_state_set(state, dp->feedback, false);
+    }
+    /* send the status information with flag 'w', batched with the other
+       changes of this poll. the s-mode api of the stack sends the data of
+       device 0 */
+    if (device == 0) {
+      APP_DP_PRINT("  Queue status to '%s' with flag: 'w'\n", info->url);
+      app_smode_queue(dp->feedback, APP_SMODE_SCOPE(APP_SMODE_SCOPE_SITE));
+    }
+  }
+  app_notify_publish(device, id, old_value, app_state_get(state, id),
+                     oc_is_redirected_request(request) ? APP_NOTIFY_S_MODE
+                                                       : APP_NOTIFY_COAP);
+  APP_DP_PRINT("-- End put %s\n", dp->name);
+  return OC_STATUS_CHANGED;
+}
+
+void
+app_dp_put_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                   void *user_data)
+{
+  (void)interfaces;
+  (void)user_data;
+  const app_dp_t *dp = app_dp_from_request(request);
+  size_t device;
+  app_state_t *state;
+  int id;
+  uint64_t start = app_shard_time_ns();
+  oc_status_t status;
+
+  g_dp_requests++;
+  if (dp == NULL) {
+    oc_send_response(request, OC_STATUS_NOT_FOUND);
+    return;
+  }
+  device = request->resource->device;
+  state = app_state_store(device);
+  id = app_dp_index(dp);
+  status = app_dp_handle_put(request, dp);
+  app_stats_request(APP_STATS_PUT, id, status,
+                    oc_is_redirected_request(request),
+                    app_shard_time_ns() - start);
+  APP_TRACE(APP_TRACE_PUT, device, id, (uint8_t)status,
+            (state != NULL) ? app_state_get(state, id) : 0);
+}
+
+void
+app_dp_register_resources(size_t device)
+{
+  int i;
+
+  for (i = 0; i < g_dp_count; i++) {
+    const app_dp_t *dp = &g_dp_table[i];
+    PRINT("Register Resource '%s' with local path \"%s\"\n", dp->name,
+          dp->url);
+    oc_resource_t *res = oc_new_resource(dp->name, dp->url, 1, device);
+    oc_resource_bind_resource_type(res, dp->rt);
+    oc_resource_bind_dpt(res, dp->dpt);
+    oc_resource_bind_content_type(res, APPLICATION_CBOR);
+    oc_resource_bind_resource_interface(res, dp->interfaces);
+    oc_resource_set_function_block_instance(res, dp->instance);
+    oc_resource_set_discoverable(res, true);
+    /* set observable
+       events are send when oc_notify_observers(oc_resource_t *resource) is
+      called. this function must be called when the value changes, preferable
+      on an interrupt when something is read from the hardware. */
+    oc_resource_set_observable(res,
+                               (dp->flags & APP_DP_FLAG_OBSERVABLE) != 0);
+    oc_resource_set_request_handler(res, OC_GET, app_dp_get_handler,
+                                    (void *)dp);
+    if (dp->flags & APP_DP_FLAG_WRITABLE) {
+      oc_resource_set_request_handler(res, OC_PUT, app_dp_put_handler,
+                                      (void *)dp);
+    }
+    oc_add_resource(res);
+  }
+}
@@ -0,0 +1,192 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * data point registry, shared by the virtual applications.
+ *
+ * Each application describes its data points in a const table.
+ * The registry builds a hash index over the urls of that table, so that
+ * the url based accessors (app_retrieve_bool_variable, ...) resolve with
+ * a single hash probe and at most one string compare.
+ *
+ * The table also drives the CoAP side: app_dp_register_resources() creates
+ * one resource per entry and binds the generic GET/PUT handlers, with the
+ * descriptor as user data.
+ * The values are kept in the state store (knx_iot_virtual_state.h), the id
+ * of a data point in the store is the index in the table.
+ */
+#ifndef KNX_IOT_VIRTUAL_DP_H
+#define KNX_IOT_VIRTUAL_DP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "oc_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef APP_DP_MAX
+#define APP_DP_MAX 256 /**< max number of data points in one application */
+#endif
+
+#ifndef APP_MAX_DEVICES
+#define APP_MAX_DEVICES 256 /**< max number of devices (instances) in one process */
+#endif
+
+#define APP_DP_NONE (-1) /**< no data point (e.g. no feedback data point) */
+
+#define APP_DP_FLAG_WRITABLE (1 << 0)   /**< data point has a PUT handler */
+#define APP_DP_FLAG_OBSERVABLE (1 << 1) /**< resource is observable */
+#define APP_DP_FLAG_FAULT (1 << 2)      /**< data point implements a fault */
+
+/**
+ * @brief the value type of a data point
+ */
+typedef enum {
+  APP_DP_BOOL = 1 /**< boolean data point (e.g. DPT_Switch) */
+} app_dp_type_t;
+
+/**
+ * @brief descriptor of a data point
+ */
+typedef struct app_dp_t
+{
+  const char *url;       /**< the url of the data point, e.g. "/p/o_1_1" */
+  const char *name;      /**< the resource name, e.g. "OnOff_1" */
+  const char *rt;        /**< the resource type, e.g. "urn:knx:dpa.417.61" */
+  const char *dpt;       /**< the data point type, e.g. "urn:knx:dpt.switch" */
+  const char *desc;      /**< the description, returned with ?m=desc */
+  oc_interface_mask_t interfaces; /**< the interface, e.g. OC_IF_A */
+  uint8_t instance;      /**< function block instance */
+  uint8_t flags;         /**< APP_DP_FLAG_xxx */
+  app_dp_type_t type;    /**< the value type */
+  int feedback;          /**< index of the feedback (info) data point or APP_DP_NONE */
+} app_dp_t;
+
+/**
+ * @brief registers the data point table of the application
+ * builds the url index, should be called once before the stack is started
+ *
+ * @param table the data point table (must stay valid)
+ * @param count the number of entries in the table
+ * @return int 0 == success
+ */
+int app_dp_registry_init(const app_dp_t *table, int count);
+
+/**
+ * @brief find the data point descriptor of an url
+ *
+ * @param url the url
+ * @return the descriptor or NULL if the url is not a data point
+ */
+const app_dp_t *app_dp_find(const char *url);
+
+/**
+ * @brief retrieve the data point descriptor by index
+ *
+ * @param index the index in the data point table
+ * @return the descriptor or NULL
+ */
+const app_dp_t *app_dp_get(int index);
+
+/**
+ * @brief the index of the descriptor in the data point table
+ *
+ * @param dp the data point descriptor
+ * @return int the index or APP_DP_NONE
+ */
+int app_dp_index(const app_dp_t *dp);
+
+/**
+ * @brief the number of registered data points
+ *
+ * @return int the amount of data points
+ */
+int app_dp_count(void);
+
+/**
+ * @brief encode the value payload { 1: value } of a data point
+ * the payload is a pre-encoded CBOR template per type and value, copied
+ * into the response buffer (no CBOR encoding per request)
+ *
+ * @param dp the data point descriptor
+ * @param value the value
+ * @return int 0 == success, -1 unknown type
+ */
+int app_dp_encode_value(const app_dp_t *dp, bool value);
+
+/**
+ * @brief the number of GET and PUT requests handled by the generic handlers
+ * (all devices), used for the request rate of the shard stats
+ *
+ * @return the number of requests
+ */
+uint32_t app_dp_request_count(void);
+
+/**
+ * @brief generic CoAP GET method for a data point
+ * the data point is resolved from the url of the resource (the stack also
+ * calls the handler for s-mode, without the user data of the resource),
+ * NOT_FOUND when the url is not a data point.
+ * without query the value is returned as { 1: value } (pre-encoded, see
+ * app_dp_encode_value), this is also the value sent by the stack with
+ * s-mode.
+ * the query ?m= returns the requested meta data (id, rt, if, dpt, ga, desc).
+ *
+ * @param request the request representation.
+ * @param interfaces the interface used for this call
+ * @param user_data not used
+ */
+void app_dp_get_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                        void *user_data);
+
+/**
+ * @brief generic CoAP PUT method for a data point
+ * the data point is resolved from the url of the resource, as for GET.
+ * accepts { 1: value }, when the data point has a feedback data point
+ * the feedback is updated (false on fault) and queued for s-mode (scope 5,
+ * see knx_iot_virtual_smode.h).
+ * the change is published to the subscribers (knx_iot_virtual_notify.h).
+ *
+ * @param request the request representation.
+ * @param interfaces the interface used for this call
+ * @param user_data not used
+ */
+void app_dp_put_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                        void *user_data);
+
+/**
+ * @brief register a resource for each data point of the registered table
+ * each resource is secure, discoverable, bound to the generic GET handler
+ * and (if writable) to the generic PUT handler.
+ * called once per device, all devices share the data point table.
+ *
+ * @param device the device index
+ */
+void app_dp_register_resources(size_t device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_DP_H */
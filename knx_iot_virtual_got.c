@@ -0,0 +1,132 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * Group Object Table index
+ *
+ * The stack does not signal writes to the Group Object Table, but the
+ * table can only be written while the device is loading. Hence the index is
+ * dropped when the device is seen loading, by the main loop after each poll
+ * (app_got_check_load_state) or by a lookup, and rebuilt (one pass over the
+ * table) on the next lookup after the load. It is also dropped by
+ * app_got_invalidate (reset), and is not used while loading.
+ * There is no group address index: the stack dispatches the received
+ * group writes to the resources itself.
+ */
+#include "knx_iot_virtual_got.h"
+#include "knx_iot_virtual_dp.h"
+
+#include "oc_api.h"
+#include "oc_core_res.h"
+#include "api/oc_knx_fp.h"
+
+#include <string.h>
+
+static bool g_got_valid = false;    /**< the index is valid */
+static int g_got_lsm = -1;          /**< load state of the index */
+static int16_t g_got_dp[APP_DP_MAX]; /**< GOT index per data point */
+
+/**
+ * @brief build the index from the Group Object Table
+ */
+static void
+app_got_build(void)
+{
+  int total = oc_core_get_group_object_table_total_size();
+  int index;
+  int i;
+
+  for (i = 0; i < APP_DP_MAX; i++) {
+    g_got_dp[i] = -1;
+  }
+  for (index = 0; index < total; index++) {
+    oc_group_object_table_t *entry =
+      oc_core_get_group_object_table_entry(index);
+    if (entry == NULL || entry->ga_len == 0) {
+      continue;
+    }
+    const app_dp_t *dp = app_dp_find(oc_string(entry->href));
+    if (dp == NULL) {
+      continue;
+    }
+    int dp_id = app_dp_index(dp);
+    if (g_got_dp[dp_id] == -1) {
+      g_got_dp[dp_id] = (int16_t)index;
+    }
+  }
+  g_got_valid = true;
+}
+
+/**
+ * @brief make sure the index is up to date
+ * @return false the Group Object Table is being loaded, do not use the index
+ */
+static bool
+app_got_ensure(void)
+{
+  oc_device_info_t *device = oc_core_get_device_info(0);
+  if (device == NULL) {
+    return false;
+  }
+  if (device->lsm_s == LSM_S_LOADING) {
+    g_got_valid = false;
+    return false;
+  }
+  if (g_got_valid == false || (int)device->lsm_s != g_got_lsm) {
+    g_got_lsm = (int)device->lsm_s;
+    app_got_build();
+  }
+  return true;
+}
+
+int
+app_got_find_dp(int dp_id)
+{
+  const app_dp_t *dp = app_dp_get(dp_id);
+  if (dp == NULL) {
+    return -1;
+  }
+  if (app_got_ensure() == false) {
+    return oc_core_find_group_object_table_url(dp->url);
+  }
+  return g_got_dp[dp_id];
+}
+
+bool
+app_got_dp_in_use(int dp_id)
+{
+  return app_got_find_dp(dp_id) > -1;
+}
+
+void
+app_got_invalidate(void)
+{
+  g_got_valid = false;
+}
+
+void
+app_got_check_load_state(void)
+{
+  oc_device_info_t *device = oc_core_get_device_info(0);
+  if (device != NULL && device->lsm_s == LSM_S_LOADING) {
+    /* the table can be rewritten: rebuild the index after the load */
+    g_got_valid = false;
+  }
+}
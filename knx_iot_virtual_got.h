@@ -0,0 +1,74 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * Group Object Table index of the data points.
+ *
+ * Maps the data points to their (first) Group Object Table entry.
+ * The index is rebuilt after the Group Object Table has been loaded
+ * (the main loop reports the load state, app_got_check_load_state) or reset
+ * (app_got_invalidate), while loading the lookups fall back to scanning the
+ * Group Object Table of the stack.
+ */
+#ifndef KNX_IOT_VIRTUAL_GOT_H
+#define KNX_IOT_VIRTUAL_GOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief retrieve the Group Object Table index of a data point
+ *
+ * @param dp_id the data point id
+ * @return the index of the first entry with the url of the data point,
+ * -1 if the data point is not in the Group Object Table
+ */
+int app_got_find_dp(int dp_id);
+
+/**
+ * @brief checks if the data point is in the Group Object Table
+ *
+ * @param dp_id the data point id
+ * @return true the data point has a Group Object Table entry
+ */
+bool app_got_dp_in_use(int dp_id);
+
+/**
+ * @brief drop the index, it will be rebuilt on the next lookup
+ * e.g. after a reset of the device (the tables are cleared)
+ */
+void app_got_invalidate(void);
+
+/**
+ * @brief drop the index when the device is loading
+ * to be called by the main loop after each oc_main_poll, so that a
+ * download (e.g. by ETS) is seen even when no lookup runs while loading
+ */
+void app_got_check_load_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_GOT_H */
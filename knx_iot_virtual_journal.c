@@ -0,0 +1,357 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * persistent data point state
+ *
+ * The journal layout:
+ * - header (8 bytes): "KXJ1", number of data points (uint16 LE), 0 (uint16)
+ * - records (6 bytes): tag (0xA0 | value | fault << 1), check byte,
+ *   data point id (uint16 LE), device (uint16 LE)
+ * The records are applied in order, the last record of a data point wins.
+ * Reading stops at the first record with a bad tag or check byte, i.e. a
+ * record that was torn by a crash.
+ * The changed data points are found with the generation counter and a
+ * snapshot diff of the state store, so the changes of all threads (stack,
+ * GUI, Pi) are written, and a data point that toggled several times in one
+ * interval costs one record.
+ */
+#include "oc_api.h"
+
+#include "knx_iot_virtual_journal.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APP_JOURNAL_MAGIC "KXJ1"  /**< the journal format */
+#define APP_JOURNAL_HEADER 8      /**< size of the header */
+#define APP_JOURNAL_RECORD 6      /**< size of a record */
+#define APP_JOURNAL_TAG 0xA0      /**< the tag bits of a record */
+#define APP_JOURNAL_TAG_MASK 0xFC /**< mask of the tag bits */
+#define APP_JOURNAL_VALUE 0x01    /**< the value bit of the tag */
+#define APP_JOURNAL_FAULT 0x02    /**< the fault bit of the tag */
+#define APP_JOURNAL_BATCH 512     /**< records per write */
+
+static FILE *g_journal = NULL;            /**< the journal, opened to append */
+static char g_journal_path[FILENAME_MAX]; /**< the path of the journal */
+static int g_journal_devices = 0;         /**< the number of devices */
+static uint32_t g_journal_records = 0;    /**< records since the compaction */
+static bool g_journal_started = false;    /**< the flush timer is running */
+
+/** the state as written to the journal, per device */
+static app_state_snapshot_t g_journal_state[APP_MAX_DEVICES];
+
+/** the records of the current write */
+static uint8_t g_journal_buffer[APP_JOURNAL_BATCH * APP_JOURNAL_RECORD];
+static int g_journal_buffer_count = 0;
+
+/**
+ * @brief the check byte of a record
+ */
+static uint8_t
+app_journal_check(const uint8_t *record)
+{
+  return (uint8_t)(record[0] ^ record[2] ^ record[3] ^ record[4] ^ record[5] ^
+                   0x5A);
+}
+
+/**
+ * @brief write the buffered records
+ */
+static int
+app_journal_write_buffer(void)
+{
+  size_t size = (size_t)g_journal_buffer_count * APP_JOURNAL_RECORD;
+  int count = g_journal_buffer_count;
+
+  g_journal_buffer_count = 0;
+  if (count == 0) {
+    return 0;
+  }
+  if (fwrite(g_journal_buffer, 1, size, g_journal) != size) {
+    PRINT("journal: can't write %s\n", g_journal_path);
+    return -1;
+  }
+  g_journal_records += (uint32_t)count;
+  return 0;
+}
+
+/**
+ * @brief buffer a record, writes the buffer when it is full
+ */
+static int
+app_journal_add(size_t device, int id, bool value, bool fault)
+{
+  uint8_t *record =
+    &g_journal_buffer[g_journal_buffer_count * APP_JOURNAL_RECORD];
+
+  record[0] = (uint8_t)(APP_JOURNAL_TAG | (value ? APP_JOURNAL_VALUE : 0) |
+                        (fault ? APP_JOURNAL_FAULT : 0));
+  record[2] = (uint8_t)(id & 0xFF);
+  record[3] = (uint8_t)((id >> 8) & 0xFF);
+  record[4] = (uint8_t)(device & 0xFF);
+  record[5] = (uint8_t)((device >> 8) & 0xFF);
+  record[1] = app_journal_check(record);
+  g_journal_buffer_count++;
+  if (g_journal_buffer_count == APP_JOURNAL_BATCH) {
+    return app_journal_write_buffer();
+  }
+  return 0;
+}
+
+/**
+ * @brief rewrite the journal with the current state
+ * written to a temporary file that is renamed over the journal
+ */
+static int
+app_journal_compact(void)
+{
+  char tmp[FILENAME_MAX + 4];
+  uint8_t header[APP_JOURNAL_HEADER];
+  int count = app_dp_count();
+  int err = 0;
+  int device;
+  int id;
+
+  if (g_journal != NULL) {
+    fclose(g_journal);
+    g_journal = NULL;
+  }
+  snprintf(tmp, sizeof(tmp), "%s.tmp", g_journal_path);
+  g_journal = fopen(tmp, "wb");
+  if (g_journal == NULL) {
+    PRINT("journal: can't create %s\n", tmp);
+    return -1;
+  }
+  memcpy(header, APP_JOURNAL_MAGIC, 4);
+  header[4] = (uint8_t)(count & 0xFF);
+  header[5] = (uint8_t)((count >> 8) & 0xFF);
+  header[6] = 0;
+  header[7] = 0;
+  if (fwrite(header, 1, sizeof(header), g_journal) != sizeof(header)) {
+    err = -1;
+  }
+  g_journal_buffer_count = 0;
+  for (device = 0; device < g_journal_devices && err == 0; device++) {
+    app_state_snapshot_t *state = &g_journal_state[device];
+    app_state_snapshot(app_state_store(device), state);
+    for (id = 0; id < count && err == 0; id++) {
+      if (APP_STATE_BIT(state->value, id) || APP_STATE_BIT(state->fault, id)) {
+        err = app_journal_add(device, id, APP_STATE_BIT(state->value, id),
+                              APP_STATE_BIT(state->fault, id));
+      }
+    }
+  }
+  if (err == 0) {
+    err = app_journal_write_buffer();
+  }
+  if (fclose(g_journal) != 0) {
+    err = -1;
+  }
+  g_journal = NULL;
+  if (err != 0) {
+    PRINT("journal: can't write %s\n", tmp);
+    remove(tmp);
+    return -1;
+  }
+#ifdef WIN32
+  /* rename does not replace an existing file on windows */
+  remove(g_journal_path);
+#endif
+  if (rename(tmp, g_journal_path) != 0) {
+    PRINT("journal: can't rename %s\n", tmp);
+    return -1;
+  }
+  g_journal = fopen(g_journal_path, "ab");
+  if (g_journal == NULL) {
+    PRINT("journal: can't open %s\n", g_journal_path);
+    return -1;
+  }
+  g_journal_records = 0;
+  return 0;
+}
+
+/**
+ * @brief read the journal and apply the records to the state stores
+ */
+static int
+app_journal_restore(void)
+{
+  FILE *in = fopen(g_journal_path, "rb");
+  uint8_t *buffer;
+  const uint8_t *record;
+  const uint8_t *end;
+  long size;
+  size_t length;
+  int count = app_dp_count();
+  int applied = 0;
+
+  if (in == NULL) {
+    return 0;
+  }
+  if (fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < APP_JOURNAL_HEADER ||
+      fseek(in, 0, SEEK_SET) != 0) {
+    fclose(in);
+    return 0;
+  }
+  buffer = (uint8_t *)malloc((size_t)size);
+  if (buffer == NULL) {
+    fclose(in);
+    return 0;
+  }
+  length = fread(buffer, 1, (size_t)size, in);
+  fclose(in);
+
+  if (length < APP_JOURNAL_HEADER || memcmp(buffer, APP_JOURNAL_MAGIC, 4) != 0 ||
+      (buffer[4] | (buffer[5] << 8)) != count) {
+    PRINT("journal: discarding %s (other format or application)\n",
+          g_journal_path);
+    free(buffer);
+    return 0;
+  }
+  end = buffer + length;
+  for (record = buffer + APP_JOURNAL_HEADER; record + APP_JOURNAL_RECORD <= end;
+       record += APP_JOURNAL_RECORD) {
+    int id = record[2] | (record[3] << 8);
+    int device = record[4] | (record[5] << 8);
+    app_state_t *state;
+
+    if ((record[0] & APP_JOURNAL_TAG_MASK) != APP_JOURNAL_TAG ||
+        record[1] != app_journal_check(record)) {
+      PRINT("journal: %s truncated at %ld\n", g_journal_path,
+            (long)(record - buffer));
+      break;
+    }
+    if (device >= g_journal_devices || id >= count) {
+      continue;
+    }
+    state = app_state_store(device);
+    app_state_set(state, id, (record[0] & APP_JOURNAL_VALUE) != 0);
+    app_state_set_fault(state, id, (record[0] & APP_JOURNAL_FAULT) != 0);
+    applied++;
+  }
+  free(buffer);
+  return applied;
+}
+
+int
+app_journal_open(const char *folder, int devices, bool restore)
+{
+  int applied = 0;
+
+  if (devices > APP_MAX_DEVICES) {
+    devices = APP_MAX_DEVICES;
+  }
+  g_journal_devices = devices;
+  snprintf(g_journal_path, sizeof(g_journal_path), "%s/%s", folder,
+           APP_JOURNAL_FILE);
+  if (restore) {
+    applied = app_journal_restore();
+    PRINT("journal: %d records restored from %s\n", applied, g_journal_path);
+  }
+  if (app_journal_compact() != 0) {
+    return -1;
+  }
+  return applied;
+}
+
+/**
+ * @brief delayed callback of the stack: the periodic flush
+ */
+static oc_event_callback_retval_t
+app_journal_flush_cb(void *data)
+{
+  (void)data;
+  app_journal_flush();
+  return OC_EVENT_CONTINUE;
+}
+
+void
+app_journal_start(void)
+{
+  if (g_journal == NULL || g_journal_started) {
+    return;
+  }
+  g_journal_started = true;
+  oc_set_delayed_callback(NULL, app_journal_flush_cb, APP_JOURNAL_INTERVAL);
+}
+
+int
+app_journal_flush(void)
+{
+  app_state_snapshot_t now;
+  uint32_t changed[APP_STATE_WORDS];
+  int count = app_dp_count();
+  int written = 0;
+  int device;
+  int word;
+  int id;
+
+  if (g_journal == NULL) {
+    return -1;
+  }
+  for (device = 0; device < g_journal_devices; device++) {
+    app_state_t *store = app_state_store(device);
+    app_state_snapshot_t *state = &g_journal_state[device];
+
+    if (app_state_generation(store) == state->generation) {
+      continue;
+    }
+    app_state_snapshot(store, &now);
+    if (app_state_diff(state, &now, changed)) {
+      for (word = 0; word < APP_STATE_WORDS; word++) {
+        if (changed[word] == 0) {
+          continue;
+        }
+        for (id = word * APP_STATE_WORD_BITS;
+             id < (word + 1) * APP_STATE_WORD_BITS && id < count; id++) {
+          if (APP_STATE_BIT(changed, id) &&
+              app_journal_add(device, id, APP_STATE_BIT(now.value, id),
+                              APP_STATE_BIT(now.fault, id)) != 0) {
+            return -1;
+          }
+          written += APP_STATE_BIT(changed, id);
+        }
+      }
+    }
+    *state = now;
+  }
+  if (app_journal_write_buffer() != 0 || fflush(g_journal) != 0) {
+    return -1;
+  }
+  if (g_journal_records > APP_JOURNAL_COMPACT_RECORDS) {
+    app_journal_compact();
+  }
+  return written;
+}
+
+void
+app_journal_close(void)
+{
+  if (g_journal == NULL) {
+    return;
+  }
+  app_journal_flush();
+  fclose(g_journal);
+  g_journal = NULL;
+  g_journal_started = false;
+}
@@ -0,0 +1,92 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * persistent data point state, shared by the virtual applications.
+ *
+ * The values and fault states of the data points (the state store) are
+ * kept in an append-only journal in the storage folder of the stack:
+ * a header and a 6 byte record per change (device, data point id, value,
+ * fault). The journal is written behind: a stack timer compares the
+ * generation of the stores once per interval and appends the data points
+ * that changed since the previous flush, with one write. The handlers do not
+ * touch the file.
+ * The journal is compacted (rewritten with only the current state, then
+ * renamed over the old one) at start up and when it holds more than
+ * APP_JOURNAL_COMPACT_RECORDS changes.
+ * There is no fsync: the journal survives a restart or a crash of the
+ * process, the changes of the last interval can be lost on a power failure.
+ */
+#ifndef KNX_IOT_VIRTUAL_JOURNAL_H
+#define KNX_IOT_VIRTUAL_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_JOURNAL_FILE "app_journal" /**< the journal in the storage folder */
+#define APP_JOURNAL_INTERVAL 1         /**< seconds between the flushes */
+#define APP_JOURNAL_COMPACT_RECORDS 4096 /**< changes before a compaction */
+
+/**
+ * @brief open the journal and restore the state stores
+ * reads the journal with one sequential read, applies the records to the
+ * state stores of devices [0..devices) and compacts the journal.
+ * An unreadable journal, or one of an application with another number of
+ * data points, is discarded.
+ * the data point registry and the state stores must be initialized
+ *
+ * @param folder the storage folder (as given to oc_storage_config)
+ * @param devices the number of devices (instances)
+ * @param restore false: discard the journal (e.g. on reset)
+ * @return int the number of records applied (0 without a journal),
+ * -1 if the journal can't be written
+ */
+int app_journal_open(const char *folder, int devices, bool restore);
+
+/**
+ * @brief start the periodic flush (stack timer)
+ * to be called after oc_main_init
+ */
+void app_journal_start(void);
+
+/**
+ * @brief append the changes since the previous flush to the journal
+ * called by the timer, compacts the journal when it is too long
+ *
+ * @return int the number of records written, -1 on error
+ */
+int app_journal_flush(void);
+
+/**
+ * @brief flush and close the journal
+ * to be called after oc_main_shutdown
+ */
+void app_journal_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_JOURNAL_H */
@@ -0,0 +1,335 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * meta data (GET ?m=) response cache
+ *
+ * Each cache entry holds the encoded map entries of all fields, in the
+ * order id, rt, if, dpt, ga, desc, with the start offset of each field.
+ * A selection of fields is written with one memcpy per field, "*" with a
+ * single memcpy.
+ * Fields that do not fit in an entry (e.g. a very long ga list) are
+ * encoded directly into the response.
+ * The entries of a device are allocated on the first ?m= request of that
+ * device, so devices that are never queried do not use cache memory.
+ */
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_virtual_got.h"
+
+#include "oc_api.h"
+#include "oc_core_res.h"
+#include "oc_rep.h"
+#include "api/oc_knx_fp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APP_META_FIELDS 6         /**< amount of meta data fields */
+#define APP_META_ENTRY_SIZE 224   /**< bytes of encoded meta data per entry */
+#define APP_META_SERIAL_SIZE 32   /**< max size of the cached serial number */
+
+/**
+ * @brief cached meta data of one data point
+ */
+typedef struct app_meta_entry_t
+{
+  uint32_t epoch;                          /**< cache epoch, 0 == empty */
+  uint8_t offset[APP_META_FIELDS + 1];     /**< start of each field */
+  uint8_t data[APP_META_ENTRY_SIZE];       /**< the encoded fields */
+} app_meta_entry_t;
+
+/**
+ * @brief the cache of one device
+ */
+typedef struct app_meta_device_t
+{
+  uint32_t epoch;                    /**< current epoch */
+  int lsm;                           /**< load state of the epoch */
+  char serial[APP_META_SERIAL_SIZE]; /**< serial number of the epoch */
+  app_meta_entry_t *entries;         /**< cache entry per data point */
+} app_meta_device_t;
+
+static app_meta_device_t g_meta[APP_MAX_DEVICES]; /**< cache per device */
+
+/**
+ * @brief the interface as string, as returned with ?m=if
+ */
+static const char *
+app_meta_if_name(oc_interface_mask_t interfaces)
+{
+  if (interfaces & OC_IF_A) {
+    return "if.a";
+  }
+  if (interfaces & OC_IF_S) {
+    return "if.s";
+  }
+  if (interfaces & OC_IF_I) {
+    return "if.i";
+  }
+  if (interfaces & OC_IF_O) {
+    return "if.o";
+  }
+  if (interfaces & OC_IF_C) {
+    return "if.c";
+  }
+  if (interfaces & OC_IF_P) {
+    return "if.p";
+  }
+  return "if.d";
+}
+
+/**
+ * @brief encode one field as map entry
+ *
+ * @param enc the encoder (root map or cache buffer)
+ * @param dp the data point
+ * @param device the device info
+ * @param field the field number (0 == id ... 5 == desc)
+ * @return the cbor error
+ */
+static CborError
+app_meta_encode_field(CborEncoder *enc, const app_dp_t *dp,
+                      oc_device_info_t *device, int field)
+{
+  CborError err = CborNoError;
+
+  switch (field) {
+  case 0: {
+    // unique identifier
+    char mystring[100];
+    snprintf(mystring, 99, "urn:knx:sn:%s%s", oc_string(device->serialnumber),
+             dp->url);
+    err |= cbor_encode_int(enc, 0);
+    err |= cbor_encode_text_stringz(enc, mystring);
+  } break;
+  case 1:
+    // resource types
+    err |= cbor_encode_text_stringz(enc, "rt");
+    err |= cbor_encode_text_stringz(enc, dp->rt);
+    break;
+  case 2:
+    // interfaces
+    err |= cbor_encode_text_stringz(enc, "if");
+    err |= cbor_encode_text_stringz(enc, app_meta_if_name(dp->interfaces));
+    break;
+  case 3:
+    err |= cbor_encode_text_stringz(enc, "dpt");
+    err |= cbor_encode_text_stringz(enc, dp->dpt);
+    break;
+  case 4: {
+    // ga
+    int index = app_got_find_dp(app_dp_index(dp));
+    if (index > -1) {
+      oc_group_object_table_t *got_table_entry =
+        oc_core_get_group_object_table_entry(index);
+      if (got_table_entry) {
+        CborEncoder ga_array;
+        int i;
+        err |= cbor_encode_text_stringz(enc, "ga");
+        err |= cbor_encoder_create_array(enc, &ga_array,
+                                         (size_t)got_table_entry->ga_len);
+        for (i = 0; i < got_table_entry->ga_len; i++) {
+          err |= cbor_encode_int(&ga_array, got_table_entry->ga[i]);
+        }
+        err |= cbor_encoder_close_container(enc, &ga_array);
+      }
+    }
+  } break;
+  case 5:
+    err |= cbor_encode_text_stringz(enc, "desc");
+    err |= cbor_encode_text_stringz(enc, dp->desc);
+    break;
+  default:
+    break;
+  }
+  return err;
+}
+
+/**
+ * @brief copy encoded map entries into the root object
+ */
+static void
+app_meta_write(const uint8_t *data, size_t len)
+{
+  if (len == 0) {
+    return;
+  }
+  if (root_map.end == NULL ||
+      (size_t)(root_map.end - root_map.data.ptr) < len) {
+    g_err |= CborErrorOutOfMemory;
+    return;
+  }
+  memcpy(root_map.data.ptr, data, len);
+  root_map.data.ptr += len;
+}
+
+/**
+ * @brief start a new epoch when the serial number or load state changed
+ */
+static void
+app_meta_check_epoch(app_meta_device_t *cache, oc_device_info_t *device)
+{
+  const char *serial = oc_string(device->serialnumber);
+  if (serial == NULL) {
+    serial = "";
+  }
+  if (cache->epoch == 0 || (int)device->lsm_s != cache->lsm ||
+      strncmp(serial, cache->serial, APP_META_SERIAL_SIZE) != 0) {
+    cache->lsm = (int)device->lsm_s;
+    strncpy(cache->serial, serial, APP_META_SERIAL_SIZE);
+    cache->epoch++;
+    if (cache->epoch == 0) {
+      /* 0 marks an empty entry */
+      cache->epoch = 1;
+    }
+  }
+}
+
+/**
+ * @brief fill in the cache entry of the data point
+ * @return true the entry is valid
+ */
+static bool
+app_meta_fill(app_meta_entry_t *entry, uint32_t epoch, const app_dp_t *dp,
+              oc_device_info_t *device)
+{
+  CborEncoder enc;
+  CborError err = CborNoError;
+  int field;
+
+  entry->epoch = 0;
+  cbor_encoder_init(&enc, entry->data, sizeof(entry->data), 0);
+  for (field = 0; field < APP_META_FIELDS; field++) {
+    entry->offset[field] =
+      (uint8_t)cbor_encoder_get_buffer_size(&enc, entry->data);
+    err |= app_meta_encode_field(&enc, dp, device, field);
+    if (err != CborNoError) {
+      return false;
+    }
+  }
+  entry->offset[APP_META_FIELDS] =
+    (uint8_t)cbor_encoder_get_buffer_size(&enc, entry->data);
+  entry->epoch = epoch;
+  return true;
+}
+
+uint8_t
+app_meta_parse_fields(const char *m, size_t m_len)
+{
+  static const char *names[APP_META_FIELDS] = { "id",  "rt", "if",
+                                                "dpt", "ga", "desc" };
+  uint8_t fields = 0;
+  size_t start = 0;
+
+  while (start < m_len) {
+    size_t end = start;
+    int field;
+    while (end < m_len && m[end] != ',') {
+      end++;
+    }
+    if (end - start == 1 && m[start] == '*') {
+      fields |= APP_META_ALL;
+    }
+    for (field = 0; field < APP_META_FIELDS; field++) {
+      if (end - start == strlen(names[field]) &&
+          strncmp(&m[start], names[field], end - start) == 0) {
+        fields |= (uint8_t)(1 << field);
+      }
+    }
+    start = end + 1;
+  }
+  return fields;
+}
+
+int
+app_meta_encode(const app_dp_t *dp, size_t device_index, uint8_t fields)
+{
+  oc_device_info_t *device = oc_core_get_device_info(device_index);
+  int id = app_dp_index(dp);
+  int field;
+
+  if (device == NULL || id < 0 || id >= app_dp_count() ||
+      device_index >= APP_MAX_DEVICES) {
+    return -1;
+  }
+  app_meta_device_t *cache = &g_meta[device_index];
+  if (cache->entries == NULL) {
+    cache->entries = (app_meta_entry_t *)calloc((size_t)app_dp_count(),
+                                                sizeof(app_meta_entry_t));
+  }
+  app_meta_check_epoch(cache, device);
+
+  app_meta_entry_t *entry = NULL;
+  bool cached = false;
+  if (cache->entries != NULL) {
+    entry = &cache->entries[id];
+    cached = (entry->epoch == cache->epoch);
+    if (cached == false && device->lsm_s != LSM_S_LOADING) {
+      /* the Group Object Table is stable, the entry can be (re)used */
+      cached = app_meta_fill(entry, cache->epoch, dp, device);
+    }
+  }
+  if (cached == false) {
+    for (field = 0; field < APP_META_FIELDS; field++) {
+      if (fields & (1 << field)) {
+        g_err |= app_meta_encode_field(&root_map, dp, device, field);
+      }
+    }
+    return 0;
+  }
+
+  if (fields == APP_META_ALL) {
+    app_meta_write(entry->data, entry->offset[APP_META_FIELDS]);
+    return 0;
+  }
+  for (field = 0; field < APP_META_FIELDS; field++) {
+    if (fields & (1 << field)) {
+      app_meta_write(&entry->data[entry->offset[field]],
+                     entry->offset[field + 1] - entry->offset[field]);
+    }
+  }
+  return 0;
+}
+
+void
+app_meta_invalidate(void)
+{
+  size_t device;
+  for (device = 0; device < APP_MAX_DEVICES; device++) {
+    /* forces a new epoch on the next request */
+    g_meta[device].lsm = -1;
+  }
+}
+
+void
+app_meta_check_load_state(void)
+{
+  size_t devices = oc_core_get_num_devices();
+  size_t device;
+
+  for (device = 0; device < devices && device < APP_MAX_DEVICES; device++) {
+    oc_device_info_t *info = oc_core_get_device_info(device);
+    if (info != NULL && info->lsm_s == LSM_S_LOADING) {
+      /* the tables can be rewritten: new epoch on the next request */
+      g_meta[device].lsm = -1;
+    }
+  }
+}
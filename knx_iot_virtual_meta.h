@@ -0,0 +1,92 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * meta data (GET ?m=) response cache of the data points.
+ *
+ * The meta data fields (id, rt, if, dpt, ga, desc) of a data point are
+ * encoded once as CBOR map entries and kept per data point.
+ * A GET with ?m= copies the cached bytes into the response.
+ * The cache is invalidated when the serial number or the load state of the
+ * device changes (the Group Object Table can only change while loading),
+ * when the main loop sees the device loading (app_meta_check_load_state),
+ * or explicitly with app_meta_invalidate().
+ */
+#ifndef KNX_IOT_VIRTUAL_META_H
+#define KNX_IOT_VIRTUAL_META_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "knx_iot_virtual_dp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_META_ID (1 << 0)   /**< m=id   : unique identifier */
+#define APP_META_RT (1 << 1)   /**< m=rt   : resource type */
+#define APP_META_IF (1 << 2)   /**< m=if   : interface */
+#define APP_META_DPT (1 << 3)  /**< m=dpt  : data point type */
+#define APP_META_GA (1 << 4)   /**< m=ga   : group addresses */
+#define APP_META_DESC (1 << 5) /**< m=desc : description */
+#define APP_META_ALL (0x3F)    /**< m=*    : all fields */
+
+/**
+ * @brief convert a value of the m query parameter into field bits
+ * the value can be a single field, "*" or a comma separated list
+ *
+ * @param m the value
+ * @param m_len the length of the value
+ * @return the field bits (APP_META_xxx)
+ */
+uint8_t app_meta_parse_fields(const char *m, size_t m_len);
+
+/**
+ * @brief encode the requested meta data fields into the root object
+ * the root object must have been opened with oc_rep_begin_root_object()
+ *
+ * @param dp the data point
+ * @param device_index the device of the request
+ * @param fields the field bits (APP_META_xxx)
+ * @return int 0 == success
+ */
+int app_meta_encode(const app_dp_t *dp, size_t device_index, uint8_t fields);
+
+/**
+ * @brief drop all cached meta data
+ * e.g. after changing the serial number or the Group Object Table
+ */
+void app_meta_invalidate(void);
+
+/**
+ * @brief drop the cached meta data of the devices that are loading
+ * to be called by the main loop after each oc_main_poll, so that a
+ * download (e.g. by ETS) is seen even when no ?m= request runs while
+ * loading
+ */
+void app_meta_check_load_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_META_H */
@@ -0,0 +1,179 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * data point notifications
+ *
+ * The batch is delivered from a delayed callback (0 seconds) of the stack,
+ * which runs in the next poll, after the handlers of the current one.
+ * A full batch is delivered immediately.
+ */
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_trace.h"
+
+#include "oc_api.h"
+
+/**
+ * @brief a subscription
+ */
+typedef struct app_notify_sub_t
+{
+  app_notify_cb_t cb; /**< the callback, NULL == free slot */
+  void *user_data;    /**< passed to the callback */
+  int id;             /**< the data point id or APP_NOTIFY_ALL */
+  uint8_t flags;      /**< APP_NOTIFY_FLAG_xxx */
+} app_notify_sub_t;
+
+static app_notify_sub_t g_notify_subs[APP_NOTIFY_MAX_SUBSCRIBERS];
+static app_notify_event_t g_notify_batch[APP_NOTIFY_MAX_BATCH];
+static int g_notify_batch_count = 0;    /**< events in the batch */
+static bool g_notify_scheduled = false; /**< batch delivery is scheduled */
+static int g_notify_batched = 0;        /**< subscriptions with batching */
+
+/**
+ * @brief deliver the batch to the batched subscriptions
+ */
+static void
+app_notify_deliver_batch(void)
+{
+  app_notify_event_t matched[APP_NOTIFY_MAX_BATCH];
+  int count = g_notify_batch_count;
+  int i;
+  int j;
+  int n;
+
+  g_notify_batch_count = 0;
+  for (i = 0; i < APP_NOTIFY_MAX_SUBSCRIBERS; i++) {
+    app_notify_sub_t *sub = &g_notify_subs[i];
+    if (sub->cb == NULL || (sub->flags & APP_NOTIFY_FLAG_BATCH) == 0) {
+      continue;
+    }
+    if (sub->id == APP_NOTIFY_ALL) {
+      sub->cb(g_notify_batch, count, sub->user_data);
+      continue;
+    }
+    for (j = 0, n = 0; j < count; j++) {
+      if (g_notify_batch[j].id == sub->id) {
+        matched[n++] = g_notify_batch[j];
+      }
+    }
+    if (n > 0) {
+      sub->cb(matched, n, sub->user_data);
+    }
+  }
+}
+
+/**
+ * @brief delayed callback of the stack: deliver the batch
+ */
+static oc_event_callback_retval_t
+app_notify_batch_cb(void *data)
+{
+  (void)data;
+  g_notify_scheduled = false;
+  if (g_notify_batch_count > 0) {
+    app_notify_deliver_batch();
+  }
+  return OC_EVENT_DONE;
+}
+
+int
+app_notify_subscribe(int id, uint8_t flags, app_notify_cb_t cb,
+                     void *user_data)
+{
+  int i;
+
+  if (cb == NULL || (id != APP_NOTIFY_ALL && app_dp_get(id) == NULL)) {
+    return -1;
+  }
+  for (i = 0; i < APP_NOTIFY_MAX_SUBSCRIBERS; i++) {
+    if (g_notify_subs[i].cb == NULL) {
+      g_notify_subs[i].cb = cb;
+      g_notify_subs[i].user_data = user_data;
+      g_notify_subs[i].id = id;
+      g_notify_subs[i].flags = flags;
+      if (flags & APP_NOTIFY_FLAG_BATCH) {
+        g_notify_batched++;
+      }
+      return i;
+    }
+  }
+  return -1;
+}
+
+int
+app_notify_subscribe_url(const char *url, uint8_t flags, app_notify_cb_t cb,
+                         void *user_data)
+{
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp == NULL) {
+    return -1;
+  }
+  return app_notify_subscribe(app_dp_index(dp), flags, cb, user_data);
+}
+
+void
+app_notify_unsubscribe(int handle)
+{
+  if (handle < 0 || handle >= APP_NOTIFY_MAX_SUBSCRIBERS ||
+      g_notify_subs[handle].cb == NULL) {
+    return;
+  }
+  if (g_notify_subs[handle].flags & APP_NOTIFY_FLAG_BATCH) {
+    g_notify_batched--;
+  }
+  g_notify_subs[handle].cb = NULL;
+}
+
+void
+app_notify_publish(size_t device, int id, bool old_value, bool new_value,
+                   app_notify_source_t source)
+{
+  app_notify_event_t event;
+  int i;
+
+  event.device = device;
+  event.id = id;
+  event.old_value = old_value;
+  event.new_value = new_value;
+  event.source = source;
+  APP_TRACE(APP_TRACE_NOTIFY, device, id, (uint8_t)source, new_value);
+
+  for (i = 0; i < APP_NOTIFY_MAX_SUBSCRIBERS; i++) {
+    app_notify_sub_t *sub = &g_notify_subs[i];
+    if (sub->cb != NULL && (sub->flags & APP_NOTIFY_FLAG_BATCH) == 0 &&
+        (sub->id == APP_NOTIFY_ALL || sub->id == id)) {
+      sub->cb(&event, 1, sub->user_data);
+    }
+  }
+
+  if (g_notify_batched == 0) {
+    return;
+  }
+  if (g_notify_batch_count == APP_NOTIFY_MAX_BATCH) {
+    app_notify_deliver_batch();
+  }
+  g_notify_batch[g_notify_batch_count++] = event;
+  if (g_notify_scheduled == false) {
+    g_notify_scheduled = true;
+    oc_set_delayed_callback(NULL, app_notify_batch_cb, 0);
+  }
+}
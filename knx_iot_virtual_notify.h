@@ -0,0 +1,134 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * data point notifications, shared by the virtual applications.
+ *
+ * The generic PUT handler publishes an event for each PUT on a data point:
+ * device, data point id, old and new value and the source of the PUT
+ * (s-mode or direct CoAP). Subscribers register a callback for one data
+ * point (by id or url) or for all data points; the filter is checked with
+ * one compare, so the callbacks do not need to resolve urls.
+ * Events are delivered directly (in the PUT handler), or batched: the
+ * events of one stack poll are collected and delivered with one call from
+ * a stack callback, after the handlers have run.
+ * All functions are called from the stack thread.
+ */
+#ifndef KNX_IOT_VIRTUAL_NOTIFY_H
+#define KNX_IOT_VIRTUAL_NOTIFY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_NOTIFY_MAX_SUBSCRIBERS 16 /**< max number of subscriptions */
+#define APP_NOTIFY_MAX_BATCH 64       /**< max events in one batch */
+
+#define APP_NOTIFY_ALL (-1) /**< subscribe to all data points */
+
+#define APP_NOTIFY_FLAG_BATCH (1 << 0) /**< deliver the events batched */
+
+/**
+ * @brief the source of a change
+ */
+typedef enum {
+  APP_NOTIFY_COAP = 0,   /**< direct CoAP PUT on the data point */
+  APP_NOTIFY_S_MODE = 1, /**< s-mode message (redirected by the stack) */
+  APP_NOTIFY_LOCAL = 2   /**< changed by the application itself */
+} app_notify_source_t;
+
+/**
+ * @brief a change of a data point
+ * the old value can be equal to the new value: each PUT is published
+ */
+typedef struct app_notify_event_t
+{
+  size_t device;              /**< the device index */
+  int id;                     /**< the data point id */
+  bool old_value;             /**< the value before the change */
+  bool new_value;             /**< the value after the change */
+  app_notify_source_t source; /**< the source of the change */
+} app_notify_event_t;
+
+/**
+ * Callback invoked with the events of a subscription
+ * direct delivery: count is 1, batched delivery: all events of the batch
+ * that match the filter, in order
+ *
+ * @param events the events
+ * @param count the number of events
+ * @param user_data the user data of the subscription
+ */
+typedef void (*app_notify_cb_t)(const app_notify_event_t *events, int count,
+                                void *user_data);
+
+/**
+ * @brief subscribe to the changes of a data point
+ *
+ * @param id the data point id or APP_NOTIFY_ALL
+ * @param flags APP_NOTIFY_FLAG_xxx
+ * @param cb the callback
+ * @param user_data passed to the callback
+ * @return int the subscription handle, -1 on error (table full)
+ */
+int app_notify_subscribe(int id, uint8_t flags, app_notify_cb_t cb,
+                         void *user_data);
+
+/**
+ * @brief subscribe to the changes of a data point by url
+ * the url is resolved once, the data point registry must be initialized
+ *
+ * @param url the url of the data point
+ * @param flags APP_NOTIFY_FLAG_xxx
+ * @param cb the callback
+ * @param user_data passed to the callback
+ * @return int the subscription handle, -1 on error (unknown url, table full)
+ */
+int app_notify_subscribe_url(const char *url, uint8_t flags,
+                             app_notify_cb_t cb, void *user_data);
+
+/**
+ * @brief remove a subscription
+ *
+ * @param handle the subscription handle
+ */
+void app_notify_unsubscribe(int handle);
+
+/**
+ * @brief publish a change of a data point to the subscribers
+ *
+ * @param device the device index
+ * @param id the data point id
+ * @param old_value the value before the change
+ * @param new_value the value after the change
+ * @param source the source of the change
+ */
+void app_notify_publish(size_t device, int id, bool old_value, bool new_value,
+                        app_notify_source_t source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_NOTIFY_H */
@@ -24,9 +24,17 @@
 #ifndef WX_PRECOMP
     #include <wx/wx.h>
 #endif
+#include <atomic>
 
 #define NO_MAIN
 #include "knx_iot_virtual_pb.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_state.h"
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_got.h"
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_virtual_swu.h"
+#include "knx_iot_virtual_journal.h"
 #include "api/oc_knx_dev.h"
 #include "api/oc_knx_sec.h"
 #include "api/oc_knx_fp.h"
@@ -64,6 +72,7 @@ enum
 static const wxCmdLineEntryDesc g_cmdLineDesc[] =
 {
   { wxCMD_LINE_OPTION, "s", "serialnumber", "serial number", wxCMD_LINE_VAL_STRING },
+  { wxCMD_LINE_OPTION, NULL, "scopes", "multicast scopes of the s-mode messages: link, site, both (default) or a list e.g. 2,5", wxCMD_LINE_VAL_STRING },
   { wxCMD_LINE_NONE }
 };
 
@@ -115,12 +124,15 @@ class MyApp : public wxApp
 {
 public:
   virtual bool OnInit();
+  virtual int FilterEvent(wxEvent& event);
 };
 
 class MyFrame : public wxFrame
 {
 public:
   MyFrame(char* serial_number);
+  ~MyFrame();
+  void PollStack();
 private:
   void OnGroupObjectTable(wxCommandEvent& event);
   void OnPublisherTable(wxCommandEvent& event);
@@ -133,14 +145,16 @@ private:
   void OnClearTables(wxCommandEvent& event);
   void OnExit(wxCommandEvent& event);
   void OnAbout(wxCommandEvent& event);
-  void OnTimer(wxTimerEvent& event);                
+  void OnTimer(wxTimerEvent& event);
+  void StartPollTimer(oc_clock_time_t next_event);
   void OnPressed_OnOff_1(wxCommandEvent& event); 
   void OnPressed_OnOff_2(wxCommandEvent& event); 
   void OnPressed_OnOff_3(wxCommandEvent& event); 
   void OnPressed_OnOff_4(wxCommandEvent& event); 
 
-  void updateInfoCheckBoxes();
-  void updateInfoButtons();
+  void setDataPointControl(const char* url, wxControl* control);
+  void updateDataPoint(int id, bool value);
+  void updateDataPoints();
   void updateTextButtons();
   void bool2text(bool on_off, char* text);
   void int2text(int value, char* text);
@@ -154,8 +168,22 @@ private:
   wxMenu* m_menuOptions;
   wxTimer m_timer;
   
+  // the UI control of each data point, indexed by data point id
+  wxControl* m_dp_control[APP_DP_MAX] = {};
+  // the data point values shown in the UI
+  app_state_snapshot_t m_dp_shown;
+  bool m_dp_shown_valid = false;
+  // the device info shown in the UI
+  bool m_text_shown_valid = false;
+  uint32_t m_shown_ia = 0;
+  uint64_t m_shown_iid = 0;
+  bool m_shown_pm = false;
+  int m_shown_lsm = 0;
+  bool m_shown_iid_conversion = false;
+  wxString m_shown_hostname;
+
   // sleepy information
-  int m_sleep_counter = 0;
+  oc_clock_time_t m_last_poll = 0;
   int m_sleep_seconds = 20;
 
   wxTextCtrl* m_ia_text;  // text control for internal address
@@ -185,6 +213,39 @@ private:
 
 wxIMPLEMENT_APP(MyApp);
 
+static MyFrame* g_frame = NULL; // the frame that polls the stack
+static std::atomic<bool> g_poll_pending(false); // a poll is queued
+
+/**
+ * @brief schedule a oc_main_poll on the UI thread
+ * called by signal_event_loop (from any thread) and after the UI events.
+ * only one poll is queued at the time, so a burst of messages results in
+ * a single poll.
+ */
+static void app_request_poll(void)
+{
+  if (g_frame != NULL && g_poll_pending.exchange(true) == false) {
+    g_frame->CallAfter(&MyFrame::PollStack);
+  }
+}
+
+/**
+ * @brief poll the stack after the UI events that may use the stack
+ * (buttons, check boxes, menus)
+ *
+ * @param event the event to be handled
+ * @return Event_Skip, the event is handled as usual
+ */
+int MyApp::FilterEvent(wxEvent& event)
+{
+  wxEventType type = event.GetEventType();
+  if (type == wxEVT_BUTTON || type == wxEVT_CHECKBOX || type == wxEVT_MENU) {
+    // the poll is queued, e.g. runs after the handler of the event
+    app_request_poll();
+  }
+  return Event_Skip;
+}
+
 /**
  * @brief initialization of the application
  * 
@@ -203,6 +264,17 @@ bool MyApp::OnInit()
   wxString serial_number;
   if (g_cmd->Found("s", &serial_number)) {
   }
+  wxString scopes_text;
+  if (g_cmd->Found("scopes", &scopes_text)) {
+    // scope policy of the s-mode messages, same syntax as the command line
+    // application
+    uint16_t scopes;
+    if (app_smode_parse_scopes(scopes_text.mb_str(), &scopes) != 0) {
+      wxLogError("invalid --scopes %s", scopes_text);
+      return false;
+    }
+    app_smode_set_scopes(scopes);
+  }
 
   MyFrame* frame = new MyFrame((char*)(serial_number.c_str()).AsChar());
 
@@ -396,13 +468,39 @@ MyFrame::MyFrame(char* str_serial_number)
   if (app_is_secure() == false) {
     m_secured_text->SetStyle(0, 100, (wxTextAttr(*wxRED)));
   }
+  // the UI control of each data point
+  this->setDataPointControl(URL_ONOFF_1, m_ONOFF_1);
+  this->setDataPointControl(URL_INFOONOFF_1, m_INFOONOFF_1);
+  this->setDataPointControl(URL_ONOFF_2, m_ONOFF_2);
+  this->setDataPointControl(URL_INFOONOFF_2, m_INFOONOFF_2);
+  this->setDataPointControl(URL_ONOFF_3, m_ONOFF_3);
+  this->setDataPointControl(URL_INFOONOFF_3, m_INFOONOFF_3);
+  this->setDataPointControl(URL_ONOFF_4, m_ONOFF_4);
+  this->setDataPointControl(URL_INFOONOFF_4, m_INFOONOFF_4);
   // update the UI
-  this->updateInfoCheckBoxes();
+  this->updateDataPoints();
   this->updateTextButtons();
-  this->updateInfoCheckBoxes();
-  // start the timer for UI updates and stack polls
+  // poll the stack when it signals the event loop, or when the timer
+  // for the next scheduled event of the stack expires
   m_timer.Bind(wxEVT_TIMER, &MyFrame::OnTimer, this);
-  m_timer.Start(1, wxTIMER_CONTINUOUS);  // 1 millisecond interval
+  g_frame = this;
+  app_set_wakeup_cb(app_request_poll);
+  app_request_poll();
+}
+
+/**
+ * @brief Destroy the My Frame:: My Frame object
+ * stops the polling of the stack
+ */
+MyFrame::~MyFrame()
+{
+  app_set_wakeup_cb(NULL);
+  g_frame = NULL;
+  m_timer.Stop();
+  // wait for the software image that is being written
+  app_swu_shutdown();
+  // write the last changes of the data points
+  app_journal_close();
 }
 
 /**
@@ -475,6 +573,25 @@ void MyFrame::updateTextButtons()
 
   // get the device data structure
   oc_device_info_t* device = oc_core_get_device_info(device_index);
+  const char* hostname = oc_string(device->hostname);
+  if (hostname == NULL) {
+    hostname = "";
+  }
+  if (m_text_shown_valid && m_shown_ia == device->ia &&
+      m_shown_iid == device->iid && m_shown_pm == device->pm &&
+      m_shown_lsm == (int)device->lsm_s &&
+      m_shown_iid_conversion == iid_conversion &&
+      m_shown_hostname == hostname) {
+    // nothing changed
+    return;
+  }
+  m_text_shown_valid = true;
+  m_shown_ia = device->ia;
+  m_shown_iid = device->iid;
+  m_shown_pm = device->pm;
+  m_shown_lsm = (int)device->lsm_s;
+  m_shown_iid_conversion = iid_conversion;
+  m_shown_hostname = hostname;
   // update the text labels
   // ia_0 == AAxxxxxx = AA
   // ia_1 == xxAAxxxx = AA
@@ -509,6 +626,9 @@ void MyFrame::OnClearTables(wxCommandEvent& event)
   SetStatusText("Clear Tables");
   // reset the device
   oc_knx_device_storage_reset(device_index, 7);
+  // the tables are cleared: drop the cached lookups
+  app_got_invalidate();
+  app_meta_invalidate();
   // update the UI
   this->updateTextButtons();
 }
@@ -524,6 +644,9 @@ void MyFrame::OnReset(wxCommandEvent& event)
   SetStatusText("Device Reset");
   // reset the device
   oc_knx_device_storage_reset(device_index, 2);
+  // the tables are cleared: drop the cached lookups
+  app_got_invalidate();
+  app_meta_invalidate();
   // update the UI
   this->updateTextButtons();
 }
@@ -944,66 +1067,145 @@ void MyFrame::OnAbout(wxCommandEvent& event)
 }
 
 /**
- * @brief update the UI on the timer ticks
+ * @brief the timer for the next scheduled event of the stack expired
+ *
+ * @param event triggered by the (one shot) timer
+ */
+void MyFrame::OnTimer(wxTimerEvent& event)
+{
+  this->PollStack();
+}
+
+/**
+ * @brief start the (one shot) timer for the next poll
+ *
+ * @param next_event the time of the next poll, as returned by oc_main_poll
+ */
+void MyFrame::StartPollTimer(oc_clock_time_t next_event)
+{
+  oc_clock_time_t now = oc_clock_time();
+  long ms = 1;
+  if (next_event > now) {
+    oc_clock_time_t delta = (next_event - now) * 1000 / OC_CLOCK_SECOND;
+    ms = (delta > 0x7FFFFFFF) ? 0x7FFFFFFF : (long)delta;
+    if (ms < 1) {
+      ms = 1;
+    }
+  }
+  m_timer.StartOnce(ms);
+}
+
+/**
+ * @brief poll the stack and update the UI
+ * runs on the UI thread, when the stack signalled the event loop
+ * or when the next scheduled event of the stack is due.
  * updates:
  * - check boxes
  * - info buttons
  * - text buttons
- * does a oc_main_poll to give a tick to the stack
  * takes into account if the device is sleepy
  * e.g. then it only does an poll each 20 seconds
- * @param event triggered by a timer
  */
-void MyFrame::OnTimer(wxTimerEvent& event)
+void MyFrame::PollStack()
 {
-  bool do_poll = true;
+  g_poll_pending = false;
+  oc_clock_time_t now = oc_clock_time();
   bool sleepy = m_menuOptions->IsChecked(CHECK_SLEEPY);
-  // do whatever you want to do every millisecond here
-  if (sleepy)
-  {
-    do_poll = false;
-    m_sleep_counter++;
-    if ((m_sleep_counter / 1000) > m_sleep_seconds) {
-      // only do a poll each x (20) seconds
-      do_poll = true;
-      m_sleep_counter = 0;
-    }
-    if (oc_knx_device_in_programming_mode(0)) {
-      // make sure that the device is reactive in programming mode
-      // e.g. keep on polling
-      do_poll = true;
+  // make sure that the device is reactive in programming mode
+  // e.g. keep on polling
+  if (sleepy && oc_knx_device_in_programming_mode(0) == false) {
+    // only do a poll each x (20) seconds
+    oc_clock_time_t wakeup = m_last_poll + m_sleep_seconds * OC_CLOCK_SECOND;
+    if (now < wakeup) {
+      this->StartPollTimer(wakeup);
+      return;
     }
   }
+  m_last_poll = now;
 
-  if (do_poll) {
-    oc_clock_time_t next_event;
-   next_event = oc_main_poll();
-  }
-  this->updateInfoCheckBoxes();
-  this->updateInfoButtons(); 
+  oc_clock_time_t next_event = oc_main_poll();
+  // the tables can be rewritten while loading
+  app_got_check_load_state();
+  app_meta_check_load_state();
+  this->updateDataPoints();
   this->updateTextButtons();
+  if (next_event == 0) {
+    // nothing scheduled: wait for signal_event_loop
+    m_timer.Stop();
+  } else {
+    this->StartPollTimer(next_event);
+  }
 }
 
 
 /**
- * @brief update the UI e.g. check boxes in the UI
- * updates:
- * does a oc_main_poll to give a tick to the stack
- * 
- * @param event triggered by a timer
+ * @brief register the UI control of a data point
+ * the label of the control is "name ('url') On/Off",
+ * a check box also shows the value as check
+ *
+ * @param url the url of the data point
+ * @param control the control showing the data point
  */
-void  MyFrame::updateInfoCheckBoxes()
+void MyFrame::setDataPointControl(const char* url, wxControl* control)
 {
-  bool p;  
-  p = app_retrieve_bool_variable(URL_INFOONOFF_1);
-  m_INFOONOFF_1->SetValue(p);    
-  p = app_retrieve_bool_variable(URL_INFOONOFF_2);
-  m_INFOONOFF_2->SetValue(p);    
-  p = app_retrieve_bool_variable(URL_INFOONOFF_3);
-  m_INFOONOFF_3->SetValue(p);    
-  p = app_retrieve_bool_variable(URL_INFOONOFF_4);
-  m_INFOONOFF_4->SetValue(p);  
+  int id = app_dp_index(app_dp_find(url));
+  if (id >= 0 && id < APP_DP_MAX) {
+    m_dp_control[id] = control;
+  }
+}
 
+/**
+ * @brief update the control of a data point
+ *
+ * @param id the data point id
+ * @param value the value of the data point
+ */
+void MyFrame::updateDataPoint(int id, bool value)
+{
+  const app_dp_t* dp = app_dp_get(id);
+  wxControl* control = m_dp_control[id];
+  if (dp == NULL || control == NULL) {
+    return;
+  }
+  char text[200];
+  sprintf(text, "%s ('%s')", dp->name, dp->url);
+  this->bool2text(value, text);
+  wxCheckBox* check_box = wxDynamicCast(control, wxCheckBox);
+  if (check_box) {
+    check_box->SetValue(value);
+  }
+  control->SetLabel(text);
+}
+
+/**
+ * @brief update the controls of the data points that changed
+ * the generation of the state store tells if anything changed,
+ * the difference with the shown snapshot tells which data points changed.
+ * the first call updates all controls.
+ */
+void MyFrame::updateDataPoints()
+{
+  app_state_t* state = app_state_store(0);
+  if (m_dp_shown_valid &&
+      app_state_generation(state) == m_dp_shown.generation) {
+    return;
+  }
+  app_state_snapshot_t current;
+  uint32_t changed[APP_STATE_WORDS];
+  app_state_snapshot(state, &current);
+  if (m_dp_shown_valid == false) {
+    memset(changed, 0xFF, sizeof(changed));
+  } else if (app_state_diff(&m_dp_shown, &current, changed) == false) {
+    m_dp_shown = current;
+    return;
+  }
+  m_dp_shown = current;
+  m_dp_shown_valid = true;
+  for (int id = 0; id < app_dp_count(); id++) {
+    if (APP_STATE_BIT(changed, id)) {
+      this->updateDataPoint(id, APP_STATE_BIT(current.value, id) != 0);
+    }
+  }
 }
 
 /**
@@ -1157,43 +1359,6 @@ void MyFrame::double2text(double value, char* text)
   strcat(text, new_text);
 }
 
-/**
- * @brief update the buttons
- * 
- */
-void  MyFrame::updateInfoButtons()
-{
-  char text[200];
-  bool p;
-  int p_int;
-  float f;
-  double d;
-  p = app_retrieve_bool_variable(URL_ONOFF_1);  strcpy(text, "OnOff_1 ('/p/o_1_1')");
-  this->bool2text(p, text);
-  m_ONOFF_1->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_INFOONOFF_1);  strcpy(text, "InfoOnOff_1 ('/p/o_2_2')");
-  this->bool2text(p, text);
-  m_INFOONOFF_1->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_ONOFF_2);  strcpy(text, "OnOff_2 ('/p/o_3_3')");
-  this->bool2text(p, text);
-  m_ONOFF_2->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_INFOONOFF_2);  strcpy(text, "InfoOnOff_2 ('/p/o_4_4')");
-  this->bool2text(p, text);
-  m_INFOONOFF_2->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_ONOFF_3);  strcpy(text, "OnOff_3 ('/p/o_5_5')");
-  this->bool2text(p, text);
-  m_ONOFF_3->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_INFOONOFF_3);  strcpy(text, "InfoOnOff_3 ('/p/o_6_6')");
-  this->bool2text(p, text);
-  m_INFOONOFF_3->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_ONOFF_4);  strcpy(text, "OnOff_4 ('/p/o_7_7')");
-  this->bool2text(p, text);
-  m_ONOFF_4->SetLabel(text);  
-  p = app_retrieve_bool_variable(URL_INFOONOFF_4);  strcpy(text, "InfoOnOff_4 ('/p/o_8_8')");
-  this->bool2text(p, text);
-  m_INFOONOFF_4->SetLabel(text);  
-
-}
 void MyFrame::OnPressed_OnOff_1(wxCommandEvent& event)
 {
   char url[] = "/p/o_1_1";
@@ -1206,8 +1371,7 @@ void MyFrame::OnPressed_OnOff_1(wxCommandEvent& event)
     p = true;
   }
   app_set_bool_variable(url, p);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
+  app_smode_queue_url(url, app_smode_scopes());
   sprintf(my_text, "OnOff_1 ('%s') pressed: %d", url, (int)p);
   SetStatusText(my_text);
 }   
@@ -1223,8 +1387,7 @@ void MyFrame::OnPressed_OnOff_2(wxCommandEvent& event)
     p = true;
   }
   app_set_bool_variable(url, p);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
+  app_smode_queue_url(url, app_smode_scopes());
   sprintf(my_text, "OnOff_2 ('%s') pressed: %d", url, (int)p);
   SetStatusText(my_text);
 }   
@@ -1240,8 +1403,7 @@ void MyFrame::OnPressed_OnOff_3(wxCommandEvent& event)
     p = true;
   }
   app_set_bool_variable(url, p);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
+  app_smode_queue_url(url, app_smode_scopes());
   sprintf(my_text, "OnOff_3 ('%s') pressed: %d", url, (int)p);
   SetStatusText(my_text);
 }   
@@ -1257,8 +1419,7 @@ void MyFrame::OnPressed_OnOff_4(wxCommandEvent& event)
     p = true;
   }
   app_set_bool_variable(url, p);
-  oc_do_s_mode_with_scope(2, url, "w");
-  oc_do_s_mode_with_scope(5, url, "w");
+  app_smode_queue_url(url, app_smode_scopes());
   sprintf(my_text, "OnOff_4 ('%s') pressed: %d", url, (int)p);
   SetStatusText(my_text);
 }           
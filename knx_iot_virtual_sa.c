@@ -80,6 +80,18 @@
 #include "external_header.h"
 #endif
 #include "knx_iot_virtual_sa.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_notify.h"
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_bench.h"
+#include "knx_iot_virtual_journal.h"
+#include "knx_iot_virtual_swu.h"
+#include "knx_iot_virtual_state.h"
+#include "knx_iot_virtual_got.h"
+#include "knx_iot_virtual_meta.h"
+#include "knx_iot_virtual_shard.h"
 
 #include <stdlib.h>
 #include <ctype.h>
@@ -114,31 +126,53 @@ static CRITICAL_SECTION cs;   /**< event loop variable */
 #define btoa(x) ((x) ? "true" : "false")
 volatile int quit = 0;  /**< stop variable, used by handle_signal */
 bool g_reset = false;   /**< reset variable, set by commandline arguments */
+int g_instances = 1;    /**< number of devices (instances), set by commandline arguments */
 char g_serial_number[20] = "00FA10010700";
+int g_shards = 1;       /**< number of shards (processes), set by commandline arguments */
+bool g_pin_cpu = false; /**< pin each shard on its own cpu, set by commandline arguments */
+app_shard_t g_shard = { -1, 0, 0 }; /**< the slice of instances of this process */
+char g_storage_folder[400]; /**< the storage folder of the stack */
+const char *g_storage_base = "./knx_iot_virtual_sa_creds"; /**< storage folder (Linux), the shards use sub folders */
+const char *g_bench_log = NULL; /**< benchmark event log, set by commandline arguments */
 
 
 
 
 
-volatile bool g_OnOff_1;   /**< global variable for OnOff_1 */
-volatile bool g_InfoOnOff_1;   /**< global variable for InfoOnOff_1 */
-volatile bool g_OnOff_2;   /**< global variable for OnOff_2 */
-volatile bool g_InfoOnOff_2;   /**< global variable for InfoOnOff_2 */
-volatile bool g_OnOff_3;   /**< global variable for OnOff_3 */
-volatile bool g_InfoOnOff_3;   /**< global variable for InfoOnOff_3 */
-volatile bool g_OnOff_4;   /**< global variable for OnOff_4 */
-volatile bool g_InfoOnOff_4;   /**< global variable for InfoOnOff_4 */
- 
-volatile bool g_fault_OnOff_1;   /**< global variable for fault OnOff_1 */ 
-volatile bool g_fault_OnOff_2;   /**< global variable for fault OnOff_2 */ 
-volatile bool g_fault_OnOff_3;   /**< global variable for fault OnOff_3 */ 
-volatile bool g_fault_OnOff_4;   /**< global variable for fault OnOff_4 */
-
-
-
-
 // BOOLEAN code
 
+/**
+ * @brief the data points of the application
+ * the order of the table defines the index of the data point
+ * the fault slot of OnOff_x is reflected in the feedback InfoOnOff_x
+ */
+static const app_dp_t g_app_dp[] = {
+  { URL_ONOFF_1, "OnOff_1", "urn:knx:dpa.417.61", "urn:knx:dpt.switch",
+    "On/Off switch 1", OC_IF_A, 1, APP_DP_FLAG_WRITABLE | APP_DP_FLAG_OBSERVABLE |
+    APP_DP_FLAG_FAULT, APP_DP_BOOL, 1 },
+  { URL_INFOONOFF_1, "InfoOnOff_1", "urn:knx:dpa.417.51", "urn:knx:dpt.switch",
+    "Feedback 1", OC_IF_S, 1, APP_DP_FLAG_OBSERVABLE,
+    APP_DP_BOOL, APP_DP_NONE },
+  { URL_ONOFF_2, "OnOff_2", "urn:knx:dpa.417.61", "urn:knx:dpt.switch",
+    "On/Off switch 2", OC_IF_A, 2, APP_DP_FLAG_WRITABLE | APP_DP_FLAG_OBSERVABLE |
+    APP_DP_FLAG_FAULT, APP_DP_BOOL, 3 },
+  { URL_INFOONOFF_2, "InfoOnOff_2", "urn:knx:dpa.417.51", "urn:knx:dpt.switch",
+    "Feedback 2", OC_IF_S, 2, APP_DP_FLAG_OBSERVABLE,
+    APP_DP_BOOL, APP_DP_NONE },
+  { URL_ONOFF_3, "OnOff_3", "urn:knx:dpa.417.61", "urn:knx:dpt.switch",
+    "On/Off switch 3", OC_IF_A, 3, APP_DP_FLAG_WRITABLE | APP_DP_FLAG_OBSERVABLE |
+    APP_DP_FLAG_FAULT, APP_DP_BOOL, 5 },
+  { URL_INFOONOFF_3, "InfoOnOff_3", "urn:knx:dpa.417.51", "urn:knx:dpt.switch",
+    "Feedback 3", OC_IF_S, 3, APP_DP_FLAG_OBSERVABLE,
+    APP_DP_BOOL, APP_DP_NONE },
+  { URL_ONOFF_4, "OnOff_4", "urn:knx:dpa.417.61", "urn:knx:dpt.switch",
+    "On/Off switch 4", OC_IF_A, 4, APP_DP_FLAG_WRITABLE | APP_DP_FLAG_OBSERVABLE |
+    APP_DP_FLAG_FAULT, APP_DP_BOOL, 7 },
+  { URL_INFOONOFF_4, "InfoOnOff_4", "urn:knx:dpa.417.51", "urn:knx:dpt.switch",
+    "Feedback 4", OC_IF_S, 4, APP_DP_FLAG_OBSERVABLE,
+    APP_DP_BOOL, APP_DP_NONE },
+};
+
 /**
  * @brief function to check if the url is represented by a boolean
  *
@@ -147,31 +181,8 @@ volatile bool g_fault_OnOff_4;   /**< global variable for fault OnOff_4 */
  */
 bool app_is_bool_url(char* url)
 {
-  if ( strcmp(url, URL_ONOFF_1) == 0) { 
-    return true; /**< OnOff_1 is a boolean */
-  }
-  if ( strcmp(url, URL_INFOONOFF_1) == 0) { 
-    return true; /**< InfoOnOff_1 is a boolean */
-  }
-  if ( strcmp(url, URL_ONOFF_2) == 0) { 
-    return true; /**< OnOff_2 is a boolean */
-  }
-  if ( strcmp(url, URL_INFOONOFF_2) == 0) { 
-    return true; /**< InfoOnOff_2 is a boolean */
-  }
-  if ( strcmp(url, URL_ONOFF_3) == 0) { 
-    return true; /**< OnOff_3 is a boolean */
-  }
-  if ( strcmp(url, URL_INFOONOFF_3) == 0) { 
-    return true; /**< InfoOnOff_3 is a boolean */
-  }
-  if ( strcmp(url, URL_ONOFF_4) == 0) { 
-    return true; /**< OnOff_4 is a boolean */
-  }
-  if ( strcmp(url, URL_INFOONOFF_4) == 0) { 
-    return true; /**< InfoOnOff_4 is a boolean */
-  }
-  return false;
+  const app_dp_t *dp = app_dp_find(url);
+  return (dp != NULL && dp->type == APP_DP_BOOL);
 }
 
 /**
@@ -182,38 +193,10 @@ bool app_is_bool_url(char* url)
  */
 void app_set_bool_variable(char* url, bool value) 
 {
-  if ( strcmp(url, URL_ONOFF_1) == 0) { 
-    g_OnOff_1 = value; /**< global variable for OnOff_1 */
-    return;
-  } 
-  if ( strcmp(url, URL_INFOONOFF_1) == 0) { 
-    g_InfoOnOff_1 = value; /**< global variable for InfoOnOff_1 */
-    return;
-  } 
-  if ( strcmp(url, URL_ONOFF_2) == 0) { 
-    g_OnOff_2 = value; /**< global variable for OnOff_2 */
-    return;
-  } 
-  if ( strcmp(url, URL_INFOONOFF_2) == 0) { 
-    g_InfoOnOff_2 = value; /**< global variable for InfoOnOff_2 */
-    return;
-  } 
-  if ( strcmp(url, URL_ONOFF_3) == 0) { 
-    g_OnOff_3 = value; /**< global variable for OnOff_3 */
-    return;
-  } 
-  if ( strcmp(url, URL_INFOONOFF_3) == 0) { 
-    g_InfoOnOff_3 = value; /**< global variable for InfoOnOff_3 */
-    return;
-  } 
-  if ( strcmp(url, URL_ONOFF_4) == 0) { 
-    g_OnOff_4 = value; /**< global variable for OnOff_4 */
-    return;
-  } 
-  if ( strcmp(url, URL_INFOONOFF_4) == 0) { 
-    g_InfoOnOff_4 = value; /**< global variable for InfoOnOff_4 */
-    return;
-  } 
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp != NULL && dp->type == APP_DP_BOOL) {
+    app_state_set(app_state_store(0), app_dp_index(dp), value);
+  }
 }
 
 /**
@@ -224,31 +207,10 @@ void app_set_bool_variable(char* url, bool value)
  */
 bool app_retrieve_bool_variable(char* url) 
 {
-  if ( strcmp(url, URL_ONOFF_1) == 0) { 
-    return g_OnOff_1; /**< global variable for OnOff_1 */
-  } 
-  if ( strcmp(url, URL_INFOONOFF_1) == 0) { 
-    return g_InfoOnOff_1; /**< global variable for InfoOnOff_1 */
-  } 
-  if ( strcmp(url, URL_ONOFF_2) == 0) { 
-    return g_OnOff_2; /**< global variable for OnOff_2 */
-  } 
-  if ( strcmp(url, URL_INFOONOFF_2) == 0) { 
-    return g_InfoOnOff_2; /**< global variable for InfoOnOff_2 */
-  } 
-  if ( strcmp(url, URL_ONOFF_3) == 0) { 
-    return g_OnOff_3; /**< global variable for OnOff_3 */
-  } 
-  if ( strcmp(url, URL_INFOONOFF_3) == 0) { 
-    return g_InfoOnOff_3; /**< global variable for InfoOnOff_3 */
-  } 
-  if ( strcmp(url, URL_ONOFF_4) == 0) { 
-    return g_OnOff_4; /**< global variable for OnOff_4 */
-  } 
-  if ( strcmp(url, URL_INFOONOFF_4) == 0) { 
-    return g_InfoOnOff_4; /**< global variable for InfoOnOff_4 */
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp != NULL && dp->type == APP_DP_BOOL) {
+    return app_state_get(app_state_store(0), app_dp_index(dp));
   }
-  
   return false;
 }
 
@@ -256,55 +218,24 @@ bool app_retrieve_bool_variable(char* url)
 
 /**
  * @brief set the fault (boolean) variable at the url
+ * on a fault the feedback (info) data point is set to false,
+ * when the fault is removed the feedback is restored from the current data
  *
  * @param url the url indicating the fault variable
  * @param value the value of the fault variable
  */
 void app_set_fault_variable(char* url, bool value)
-{ 
-  if ( strcmp(url, URL_ONOFF_1) == 0) { 
-    /* handling fault of OnOff_1 */
-    g_fault_OnOff_1 = value;   /**< global fault variable for OnOff_1 */
-    if (value == true) {
-      /* this is a fault is set the info variable on fault */
-      app_set_bool_variable("/p/o_2_2", false);
-    } else {
-      /* restore the value from the current data*/
-      app_set_bool_variable("/p/o_2_2", g_OnOff_1); 
-    }
-  } 
-  if ( strcmp(url, URL_ONOFF_2) == 0) { 
-    /* handling fault of OnOff_2 */
-    g_fault_OnOff_2 = value;   /**< global fault variable for OnOff_2 */
-    if (value == true) {
-      /* this is a fault is set the info variable on fault */
-      app_set_bool_variable("/p/o_4_4", false);
-    } else {
-      /* restore the value from the current data*/
-      app_set_bool_variable("/p/o_4_4", g_OnOff_2); 
-    }
-  } 
-  if ( strcmp(url, URL_ONOFF_3) == 0) { 
-    /* handling fault of OnOff_3 */
-    g_fault_OnOff_3 = value;   /**< global fault variable for OnOff_3 */
-    if (value == true) {
-      /* this is a fault is set the info variable on fault */
-      app_set_bool_variable("/p/o_6_6", false);
-    } else {
-      /* restore the value from the current data*/
-      app_set_bool_variable("/p/o_6_6", g_OnOff_3); 
-    }
-  } 
-  if ( strcmp(url, URL_ONOFF_4) == 0) { 
-    /* handling fault of OnOff_4 */
-    g_fault_OnOff_4 = value;   /**< global fault variable for OnOff_4 */
-    if (value == true) {
-      /* this is a fault is set the info variable on fault */
-      app_set_bool_variable("/p/o_8_8", false);
-    } else {
-      /* restore the value from the current data*/
-      app_set_bool_variable("/p/o_8_8", g_OnOff_4); 
-    }
+{
+  app_state_t *state = app_state_store(0);
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp == NULL || (dp->flags & APP_DP_FLAG_FAULT) == 0) {
+    return;
+  }
+  int id = app_dp_index(dp);
+  app_state_set_fault(state, id, value);
+  if (dp->feedback != APP_DP_NONE) {
+    app_state_set(state, dp->feedback,
+                  (value == true) ? false : app_state_get(state, id));
   }
 }
 
@@ -316,21 +247,28 @@ void app_set_fault_variable(char* url, bool value)
  */
 bool app_retrieve_fault_variable(char* url)
 { 
-  if ( strcmp(url, URL_ONOFF_1) == 0) { 
-    return g_fault_OnOff_1;   /**< global variable for OnOff_1 */
-  } 
-  if ( strcmp(url, URL_ONOFF_2) == 0) { 
-    return g_fault_OnOff_2;   /**< global variable for OnOff_2 */
-  } 
-  if ( strcmp(url, URL_ONOFF_3) == 0) { 
-    return g_fault_OnOff_3;   /**< global variable for OnOff_3 */
-  } 
-  if ( strcmp(url, URL_ONOFF_4) == 0) { 
-    return g_fault_OnOff_4;   /**< global variable for OnOff_4 */
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp != NULL && (dp->flags & APP_DP_FLAG_FAULT) != 0) {
+    return app_state_get_fault(app_state_store(0), app_dp_index(dp));
   }
   return false;
 }
 
+/**
+ * @brief checks if the url is in use (e.g. used in the Group Object Table)
+ *
+ * @param url the url of the resource/data point
+ * @return true: entry in Group Object Table has the URL
+ */
+bool app_is_url_in_use(char* url)
+{
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp == NULL) {
+    return false;
+  }
+  return app_got_dp_in_use(app_dp_index(dp));
+}
+
 // PARAMETER code
 
 bool app_is_url_parameter(char* url)
@@ -358,11 +296,31 @@ bool app_is_secure()
 }
 
 static oc_put_struct_t app_put = { NULL };
+static int app_put_subscription = -1;
+
+/**
+ * @brief forwards the data point notifications to the put callback (url)
+ */
+static void
+app_put_notify(const app_notify_event_t *events, int count, void *user_data)
+{
+  (void)user_data;
+  for (int i = 0; i < count; i++) {
+    const app_dp_t *dp = app_dp_get(events[i].id);
+    if (dp != NULL && app_put.cb != NULL) {
+      app_put.cb((char *)dp->url);
+    }
+  }
+}
 
 void
 app_set_put_cb(oc_put_cb_t cb)
 {
   app_put.cb = cb;
+  if (app_put_subscription < 0) {
+    app_put_subscription =
+      app_notify_subscribe(APP_NOTIFY_ALL, 0, app_put_notify, NULL);
+  }
 }
 
 oc_put_struct_t *
@@ -371,6 +329,14 @@ oc_get_put_cb(void)
   return &app_put;
 }
 
+static app_wakeup_cb_t app_wakeup = NULL;
+
+void
+app_set_wakeup_cb(app_wakeup_cb_t cb)
+{
+  app_wakeup = cb;
+}
+
 void do_put_cb(char* url) 
 {
   oc_put_struct_t *my_cb = oc_get_put_cb();
@@ -466,32 +432,38 @@ app_init(void)
   int ret = oc_init_platform("cascoda", NULL, NULL);
   char serial_number_uppercase[20];
 
-  /* set the application name, version, base url, device serial number */
-  ret |= oc_add_device(MY_NAME, "1.0.0", "//", g_serial_number, NULL, NULL);
+  /* set the application name, version, base url, device serial number
+     each instance is a device, the serial numbers of the instances are
+     incremented from the serial number set with -s or --serial-base */
+  for (int i = 0; i < g_instances; i++) {
+    char serial_number[20];
+    app_shard_serial_number(g_serial_number, i, serial_number,
+                            sizeof(serial_number));
+    ret |= oc_add_device(MY_NAME, "1.0.0", "//", serial_number, NULL, NULL);
 
-  oc_device_info_t *device = oc_core_get_device_info(0);
+    /* set the hardware version 0.7.0 */
+    oc_core_set_device_hwv(i, 0, 7, 0);
 
-  
-  /* set the hardware version 0.7.0 */
-  oc_core_set_device_hwv(0, 0, 7, 0);
-  
-  /* set the firmware version 0.7.0 */
-  oc_core_set_device_fwv(0, 0, 7, 0);
+    /* set the firmware version 0.7.0 */
+    oc_core_set_device_fwv(i, 0, 7, 0);
 
-  char mid[5];
-  strncpy(mid, g_serial_number, 5); // mid = first 4 digits of sn
-  mid[4] = '\0';
-  long int mid_num = strtol(mid, NULL, 16);
+    char mid[5];
+    strncpy(mid, serial_number, 5); // mid = first 4 digits of sn
+    mid[4] = '\0';
+    long int mid_num = strtol(mid, NULL, 16);
 
-  /* manufactorer id */
-  oc_core_set_device_mid(0, (uint32_t)mid_num);
-  
-  /* set the hardware type*/
-  //                         123456789012
-  oc_core_set_device_hwt(0, "000000000001");
+    /* manufactorer id */
+    oc_core_set_device_mid(i, (uint32_t)mid_num);
 
-  /* set the model */
-  oc_core_set_device_model(0, "KNX virtual - SA");
+    /* set the hardware type*/
+    //                         123456789012
+    oc_core_set_device_hwt(i, "000000000001");
+
+    /* set the model */
+    oc_core_set_device_model(i, "KNX virtual - SA");
+  }
+
+  oc_device_info_t *device = oc_core_get_device_info(0);
 
   oc_set_s_mode_response_cb(oc_add_s_mode_response_cb);
 #define PASSWORD "0MK4U5LV950ST3VRXL8G"
@@ -517,1128 +489,7 @@ char* app_get_password()
 }
 
 // data point (objects) handling
-
-
-/**
- * @brief CoAP GET method for data point "OnOff_1" resource at url URL_ONOFF_1 ("/p/o_1_1").
- * resource types: ['urn:knx:dpa.417.61']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_OnOff_1(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_OnOff_1 %s \n", URL_ONOFF_1);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.61");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.a");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "On/Off switch 1");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_OnOff_1);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_OnOff_1\n");
-}
-
- 
-/**
- * @brief CoAP PUT method for data point "OnOff_1" resource at url "/p/o_1_1".
- * resource types: ['urn:knx:dpa.417.61']
- * The function has as input the request body, which are the input values of the
- * PUT method.
- * The input values (as a set) are checked if all supplied values are correct.
- * If the input values are correct, they will be assigned to the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the used interfaces during the request.
- * @param user_data the supplied user data.
- */
-void
-put_OnOff_1(oc_request_t *request, oc_interface_mask_t interfaces,
-                void *user_data)
-{
-  (void)interfaces;
-  (void)user_data;
-  bool error_state = true;
-  PRINT("-- Begin put_OnOff_1:\n");
-
-  oc_rep_t *rep = NULL;
-  /* handle the different requests e.g. via s-mode or normal CoAP call*/
-  if (oc_is_redirected_request(request)) {
-    PRINT("  redirected request..\n");
-  }
-  rep = request->request_payload;
-  /* loop over all the entries in the request */
-  /* handle the type of payload correctly. */
-  error_state = true;
-  while (rep != NULL) {
-    /* handle the type of payload correctly. */
-    if ((rep->iname == 1) && (rep->type == OC_REP_BOOL)) {
-      PRINT("  put_OnOff_1 received : %d\n", rep->value.boolean);
-      g_OnOff_1 = rep->value.boolean;
-      error_state = false;
-      break;
-    }
-  }
-
-  if (error_state == false){
-      oc_send_cbor_response(request, OC_STATUS_CHANGED);
-      /* update the status information of InfoOnOff_1*/
-      if (g_fault_OnOff_1 == false) { 
-        PRINT("  No Fault update feedback to %d'\n", g_OnOff_1);
-        /* no fault hence update the feedback with the current state of the actuator */
-        g_InfoOnOff_1 = g_OnOff_1;  
-      } else {
-        /* fault hence update the feedback with "false" */
-        PRINT("  Fault'\n");
-        g_InfoOnOff_1 = false; 
-      }
-      /* send the status information InfoOnOff_1 to '/p/o_2_2' with flag 'w' */
-      PRINT("  Send status to '/p/o_2_2' with flag: 'w'\n");
-      oc_do_s_mode_with_scope(5, URL_INFOONOFF_1, "w"); 
-      do_put_cb(URL_ONOFF_1);
-      PRINT("-- End put_OnOff_1\n");
-      return;
-  }
-  /* request data was not recognized, so it was a bad request */
-  oc_send_response(request, OC_STATUS_BAD_REQUEST);
-  PRINT("-- End put_OnOff_1\n");
-}
-
-/**
- * @brief CoAP GET method for data point "InfoOnOff_1" resource at url URL_INFOONOFF_1 ("/p/o_2_2").
- * resource types: ['urn:knx:dpa.417.51']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_InfoOnOff_1(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_InfoOnOff_1 %s \n", URL_INFOONOFF_1);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.51");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.s");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "Feedback 1");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_InfoOnOff_1);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_InfoOnOff_1\n");
-}
-
-
-
-/**
- * @brief CoAP GET method for data point "OnOff_2" resource at url URL_ONOFF_2 ("/p/o_3_3").
- * resource types: ['urn:knx:dpa.417.61']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_OnOff_2(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_OnOff_2 %s \n", URL_ONOFF_2);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.61");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.a");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "On/Off switch 2");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_OnOff_2);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_OnOff_2\n");
-}
-
- 
-/**
- * @brief CoAP PUT method for data point "OnOff_2" resource at url "/p/o_3_3".
- * resource types: ['urn:knx:dpa.417.61']
- * The function has as input the request body, which are the input values of the
- * PUT method.
- * The input values (as a set) are checked if all supplied values are correct.
- * If the input values are correct, they will be assigned to the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the used interfaces during the request.
- * @param user_data the supplied user data.
- */
-void
-put_OnOff_2(oc_request_t *request, oc_interface_mask_t interfaces,
-                void *user_data)
-{
-  (void)interfaces;
-  (void)user_data;
-  bool error_state = true;
-  PRINT("-- Begin put_OnOff_2:\n");
-
-  oc_rep_t *rep = NULL;
-  /* handle the different requests e.g. via s-mode or normal CoAP call*/
-  if (oc_is_redirected_request(request)) {
-    PRINT("  redirected request..\n");
-  }
-  rep = request->request_payload;
-  /* loop over all the entries in the request */
-  /* handle the type of payload correctly. */
-  error_state = true;
-  while (rep != NULL) {
-    /* handle the type of payload correctly. */
-    if ((rep->iname == 1) && (rep->type == OC_REP_BOOL)) {
-      PRINT("  put_OnOff_2 received : %d\n", rep->value.boolean);
-      g_OnOff_2 = rep->value.boolean;
-      error_state = false;
-      break;
-    }
-  }
-
-  if (error_state == false){
-      oc_send_cbor_response(request, OC_STATUS_CHANGED);
-      /* update the status information of InfoOnOff_2*/
-      if (g_fault_OnOff_2 == false) { 
-        PRINT("  No Fault update feedback to %d'\n", g_OnOff_2);
-        /* no fault hence update the feedback with the current state of the actuator */
-        g_InfoOnOff_2 = g_OnOff_2;  
-      } else {
-        /* fault hence update the feedback with "false" */
-        PRINT("  Fault'\n");
-        g_InfoOnOff_2 = false; 
-      }
-      /* send the status information InfoOnOff_2 to '/p/o_4_4' with flag 'w' */
-      PRINT("  Send status to '/p/o_4_4' with flag: 'w'\n");
-      oc_do_s_mode_with_scope(5, URL_INFOONOFF_2, "w"); 
-      do_put_cb(URL_ONOFF_2);
-      PRINT("-- End put_OnOff_2\n");
-      return;
-  }
-  /* request data was not recognized, so it was a bad request */
-  oc_send_response(request, OC_STATUS_BAD_REQUEST);
-  PRINT("-- End put_OnOff_2\n");
-}
-
-/**
- * @brief CoAP GET method for data point "InfoOnOff_2" resource at url URL_INFOONOFF_2 ("/p/o_4_4").
- * resource types: ['urn:knx:dpa.417.51']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_InfoOnOff_2(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_InfoOnOff_2 %s \n", URL_INFOONOFF_2);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.51");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.s");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "Feedback 2");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_InfoOnOff_2);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_InfoOnOff_2\n");
-}
-
-
-
-/**
- * @brief CoAP GET method for data point "OnOff_3" resource at url URL_ONOFF_3 ("/p/o_5_5").
- * resource types: ['urn:knx:dpa.417.61']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_OnOff_3(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_OnOff_3 %s \n", URL_ONOFF_3);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.61");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.a");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "On/Off switch 3");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_OnOff_3);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_OnOff_3\n");
-}
-
- 
-/**
- * @brief CoAP PUT method for data point "OnOff_3" resource at url "/p/o_5_5".
- * resource types: ['urn:knx:dpa.417.61']
- * The function has as input the request body, which are the input values of the
- * PUT method.
- * The input values (as a set) are checked if all supplied values are correct.
- * If the input values are correct, they will be assigned to the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the used interfaces during the request.
- * @param user_data the supplied user data.
- */
-void
-put_OnOff_3(oc_request_t *request, oc_interface_mask_t interfaces,
-                void *user_data)
-{
-  (void)interfaces;
-  (void)user_data;
-  bool error_state = true;
-  PRINT("-- Begin put_OnOff_3:\n");
-
-  oc_rep_t *rep = NULL;
-  /* handle the different requests e.g. via s-mode or normal CoAP call*/
-  if (oc_is_redirected_request(request)) {
-    PRINT("  redirected request..\n");
-  }
-  rep = request->request_payload;
-  /* loop over all the entries in the request */
-  /* handle the type of payload correctly. */
-  error_state = true;
-  while (rep != NULL) {
-    /* handle the type of payload correctly. */
-    if ((rep->iname == 1) && (rep->type == OC_REP_BOOL)) {
-      PRINT("  put_OnOff_3 received : %d\n", rep->value.boolean);
-      g_OnOff_3 = rep->value.boolean;
-      error_state = false;
-      break;
-    }
-  }
-
-  if (error_state == false){
-      oc_send_cbor_response(request, OC_STATUS_CHANGED);
-      /* update the status information of InfoOnOff_3*/
-      if (g_fault_OnOff_3 == false) { 
-        PRINT("  No Fault update feedback to %d'\n", g_OnOff_3);
-        /* no fault hence update the feedback with the current state of the actuator */
-        g_InfoOnOff_3 = g_OnOff_3;  
-      } else {
-        /* fault hence update the feedback with "false" */
-        PRINT("  Fault'\n");
-        g_InfoOnOff_3 = false; 
-      }
-      /* send the status information InfoOnOff_3 to '/p/o_6_6' with flag 'w' */
-      PRINT("  Send status to '/p/o_6_6' with flag: 'w'\n");
-      oc_do_s_mode_with_scope(5, URL_INFOONOFF_3, "w"); 
-      do_put_cb(URL_ONOFF_3);
-      PRINT("-- End put_OnOff_3\n");
-      return;
-  }
-  /* request data was not recognized, so it was a bad request */
-  oc_send_response(request, OC_STATUS_BAD_REQUEST);
-  PRINT("-- End put_OnOff_3\n");
-}
-
-/**
- * @brief CoAP GET method for data point "InfoOnOff_3" resource at url URL_INFOONOFF_3 ("/p/o_6_6").
- * resource types: ['urn:knx:dpa.417.51']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_InfoOnOff_3(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_InfoOnOff_3 %s \n", URL_INFOONOFF_3);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 0, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.51");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.s");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "Feedback 3");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_InfoOnOff_3);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_InfoOnOff_3\n");
-}
-
-
-
-/**
- * @brief CoAP GET method for data point "OnOff_4" resource at url URL_ONOFF_4 ("/p/o_7_7").
- * resource types: ['urn:knx:dpa.417.61']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_OnOff_4(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_OnOff_4 %s \n", URL_ONOFF_4);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 9, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.61");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.a");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "On/Off switch 4");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_OnOff_4);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_OnOff_4\n");
-}
-
- 
-/**
- * @brief CoAP PUT method for data point "OnOff_4" resource at url "/p/o_7_7".
- * resource types: ['urn:knx:dpa.417.61']
- * The function has as input the request body, which are the input values of the
- * PUT method.
- * The input values (as a set) are checked if all supplied values are correct.
- * If the input values are correct, they will be assigned to the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the used interfaces during the request.
- * @param user_data the supplied user data.
- */
-void
-put_OnOff_4(oc_request_t *request, oc_interface_mask_t interfaces,
-                void *user_data)
-{
-  (void)interfaces;
-  (void)user_data;
-  bool error_state = true;
-  PRINT("-- Begin put_OnOff_4:\n");
-
-  oc_rep_t *rep = NULL;
-  /* handle the different requests e.g. via s-mode or normal CoAP call*/
-  if (oc_is_redirected_request(request)) {
-    PRINT("  redirected request..\n");
-  }
-  rep = request->request_payload;
-  /* loop over all the entries in the request */
-  /* handle the type of payload correctly. */
-  error_state = true;
-  while (rep != NULL) {
-    /* handle the type of payload correctly. */
-    if ((rep->iname == 1) && (rep->type == OC_REP_BOOL)) {
-      PRINT("  put_OnOff_4 received : %d\n", rep->value.boolean);
-      g_OnOff_4 = rep->value.boolean;
-      error_state = false;
-      break;
-    }
-  }
-
-  if (error_state == false){
-      oc_send_cbor_response(request, OC_STATUS_CHANGED);
-      /* update the status information of InfoOnOff_4*/
-      if (g_fault_OnOff_4 == false) { 
-        PRINT("  No Fault update feedback to %d'\n", g_OnOff_4);
-        /* no fault hence update the feedback with the current state of the actuator */
-        g_InfoOnOff_4 = g_OnOff_4;  
-      } else {
-        /* fault hence update the feedback with "false" */
-        PRINT("  Fault'\n");
-        g_InfoOnOff_4 = false; 
-      }
-      /* send the status information InfoOnOff_4 to '/p/o_8_8' with flag 'w' */
-      PRINT("  Send status to '/p/o_8_8' with flag: 'w'\n");
-      oc_do_s_mode_with_scope(5, URL_INFOONOFF_4, "w"); 
-      do_put_cb(URL_ONOFF_4);
-      PRINT("-- End put_OnOff_4\n");
-      return;
-  }
-  /* request data was not recognized, so it was a bad request */
-  oc_send_response(request, OC_STATUS_BAD_REQUEST);
-  PRINT("-- End put_OnOff_4\n");
-}
-
-/**
- * @brief CoAP GET method for data point "InfoOnOff_4" resource at url URL_INFOONOFF_4 ("/p/o_8_8").
- * resource types: ['urn:knx:dpa.417.51']
- * function is called to initialize the return values of the GET method.
- * initialization of the returned values are done from the global property
- * values. 
- *
- * @param request the request representation.
- * @param interfaces the interface used for this call
- * @param user_data the user data.
- */
-void
-get_InfoOnOff_4(oc_request_t *request, oc_interface_mask_t interfaces,
-               void *user_data)
-{
-  (void)user_data; /* variable not used */
-
-  /* MANUFACTORER: SENSOR add here the code to talk to the HW if one implements a
-     sensor. the call to the HW needs to fill in the global variable before it
-     returns to this function here. alternative is to have a callback from the
-     hardware that sets the global variables.
-  */
-  bool error_state = false; /* the error state, the generated code */
-
-  PRINT("-- Begin get_InfoOnOff_4 %s \n", URL_INFOONOFF_4);
-  /* check if the accept header is CBOR */
-  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-    return;
-  }
-
-  // check the query parameter m with the various values
-  char *m;
-  char* m_key;
-  size_t m_key_len;
-  size_t m_len = (int)oc_get_query_value(request, "m", &m);
-  if (m_len != -1) {
-    PRINT("  Query param: %.*s",(int)m_len, m);
-    oc_init_query_iterator();
-    size_t device_index = request->resource->device;
-    oc_device_info_t *device = oc_core_get_device_info(device_index);
-    if (device != NULL) {
-      oc_rep_begin_root_object();
-      while (oc_iterate_query(request, &m_key, &m_key_len, &m, &m_len) != -1) {
-        // unique identifier
-        if ((strncmp(m, "id", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          char mystring[100];
-          snprintf(mystring,99,"urn:knx:sn:%s%s",oc_string(device->serialnumber),
-           oc_string(request->resource->uri));
-          oc_rep_i_set_text_string(root, 9, mystring);
-        }
-        // resource types
-        if ((strncmp(m, "rt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, rt, "urn:knx:dpa.417.51");
-        }
-        // interfaces
-        if ((strncmp(m, "if", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, if, "if.s");
-        }
-        if ((strncmp(m, "dpt", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, dpt, oc_string(request->resource->dpt));
-        }
-        // ga
-        if ((strncmp(m, "ga", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          int index = oc_core_find_group_object_table_url(oc_string(request->resource->uri));
-          if (index > -1) {
-             oc_group_object_table_t* got_table_entry = oc_core_get_group_object_table_entry(index);
-             if (got_table_entry) {
-               oc_rep_set_int_array(root, ga, got_table_entry->ga, got_table_entry->ga_len);
-             }
-          }
-        }
-        if ((strncmp(m, "desc", m_len) == 0) |
-            (strncmp(m, "*", m_len) == 0) ) {
-          oc_rep_set_text_string(root, desc, "Feedback 4");
-        }
-      } /* query iterator */
-      oc_rep_end_root_object();
-    } else {
-      /* device is NULL */
-      oc_send_cbor_response(request, OC_STATUS_BAD_OPTION);
-    }
-    oc_send_cbor_response(request, OC_STATUS_OK);
-    return;
-  }
-  oc_rep_begin_root_object();
-  oc_rep_i_set_boolean(root, 1, g_InfoOnOff_4);
-  oc_rep_end_root_object(); 
-  
-  if (g_err) {
-    error_state = true;
-  }
-  PRINT("CBOR encoder size %d\n", oc_rep_get_encoded_payload_size());
-  if (error_state == false) {
-    oc_send_cbor_response(request, OC_STATUS_OK);
-  } else {
-    oc_send_response(request, OC_STATUS_BAD_OPTION);
-  }
-  PRINT("-- End get_InfoOnOff_4\n");
-}
-
-
-
+// the generic GET/PUT handlers are in knx_iot_virtual_dp.c
 
 // parameters handling
 
@@ -1647,8 +498,9 @@ get_InfoOnOff_4(oc_request_t *request, oc_interface_mask_t interfaces,
 /**
  * @brief register all the data point resources to the stack
  * this function registers all data point level resources:
- * - each resource path is bind to a specific function for the supported methods
- *  (GET, PUT)
+ * - each entry of the data point table (g_app_dp) is registered as resource
+ * - each resource path is bind to the generic GET/PUT handlers,
+ *   the descriptor of the data point is passed in as user data
  * - each resource is
  *   - secure
  *   - observable
@@ -1660,171 +512,14 @@ get_InfoOnOff_4(oc_request_t *request, oc_interface_mask_t interfaces,
 void
 register_resources(void)
 {
-  PRINT("Register Resource 'OnOff_1' with local path \"%s\"\n", URL_ONOFF_1);
-  oc_resource_t *res_OnOff_1 =
-    oc_new_resource("OnOff_1", URL_ONOFF_1, 1, 0);
-  oc_resource_bind_resource_type(res_OnOff_1, "urn:knx:dpa.417.61");
-  oc_resource_bind_dpt(res_OnOff_1, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_OnOff_1, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_OnOff_1, OC_IF_A); /* if.a */ 
-  oc_resource_set_function_block_instance(res_OnOff_1, 1); /* instance 1 */ 
-  oc_resource_set_discoverable(res_OnOff_1, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_OnOff_1, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_OnOff_1, true);
-  oc_resource_set_request_handler(res_OnOff_1, OC_GET, get_OnOff_1, NULL);
-  oc_resource_set_request_handler(res_OnOff_1, OC_PUT, put_OnOff_1, NULL); 
-  oc_add_resource(res_OnOff_1);
-  PRINT("Register Resource 'InfoOnOff_1' with local path \"%s\"\n", URL_INFOONOFF_1);
-  oc_resource_t *res_InfoOnOff_1 =
-    oc_new_resource("InfoOnOff_1", URL_INFOONOFF_1, 1, 0);
-  oc_resource_bind_resource_type(res_InfoOnOff_1, "urn:knx:dpa.417.51");
-  oc_resource_bind_dpt(res_InfoOnOff_1, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_InfoOnOff_1, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_InfoOnOff_1, OC_IF_S); /* if.s */ 
-  oc_resource_set_function_block_instance(res_InfoOnOff_1, 1); /* instance 1 */ 
-  oc_resource_set_discoverable(res_InfoOnOff_1, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_InfoOnOff_1, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_InfoOnOff_1, true);
-  oc_resource_set_request_handler(res_InfoOnOff_1, OC_GET, get_InfoOnOff_1, NULL);
-  oc_add_resource(res_InfoOnOff_1);
-  PRINT("Register Resource 'OnOff_2' with local path \"%s\"\n", URL_ONOFF_2);
-  oc_resource_t *res_OnOff_2 =
-    oc_new_resource("OnOff_2", URL_ONOFF_2, 1, 0);
-  oc_resource_bind_resource_type(res_OnOff_2, "urn:knx:dpa.417.61");
-  oc_resource_bind_dpt(res_OnOff_2, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_OnOff_2, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_OnOff_2, OC_IF_A); /* if.a */ 
-  oc_resource_set_function_block_instance(res_OnOff_2, 2); /* instance 2 */ 
-  oc_resource_set_discoverable(res_OnOff_2, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_OnOff_2, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_OnOff_2, true);
-  oc_resource_set_request_handler(res_OnOff_2, OC_GET, get_OnOff_2, NULL);
-  oc_resource_set_request_handler(res_OnOff_2, OC_PUT, put_OnOff_2, NULL); 
-  oc_add_resource(res_OnOff_2);
-  PRINT("Register Resource 'InfoOnOff_2' with local path \"%s\"\n", URL_INFOONOFF_2);
-  oc_resource_t *res_InfoOnOff_2 =
-    oc_new_resource("InfoOnOff_2", URL_INFOONOFF_2, 1, 0);
-  oc_resource_bind_resource_type(res_InfoOnOff_2, "urn:knx:dpa.417.51");
-  oc_resource_bind_dpt(res_InfoOnOff_2, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_InfoOnOff_2, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_InfoOnOff_2, OC_IF_S); /* if.s */ 
-  oc_resource_set_function_block_instance(res_InfoOnOff_2, 2); /* instance 2 */ 
-  oc_resource_set_discoverable(res_InfoOnOff_2, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_InfoOnOff_2, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_InfoOnOff_2, true);
-  oc_resource_set_request_handler(res_InfoOnOff_2, OC_GET, get_InfoOnOff_2, NULL);
-  oc_add_resource(res_InfoOnOff_2);
-  PRINT("Register Resource 'OnOff_3' with local path \"%s\"\n", URL_ONOFF_3);
-  oc_resource_t *res_OnOff_3 =
-    oc_new_resource("OnOff_3", URL_ONOFF_3, 1, 0);
-  oc_resource_bind_resource_type(res_OnOff_3, "urn:knx:dpa.417.61");
-  oc_resource_bind_dpt(res_OnOff_3, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_OnOff_3, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_OnOff_3, OC_IF_A); /* if.a */ 
-  oc_resource_set_function_block_instance(res_OnOff_3, 3); /* instance 3 */ 
-  oc_resource_set_discoverable(res_OnOff_3, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_OnOff_3, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_OnOff_3, true);
-  oc_resource_set_request_handler(res_OnOff_3, OC_GET, get_OnOff_3, NULL);
-  oc_resource_set_request_handler(res_OnOff_3, OC_PUT, put_OnOff_3, NULL); 
-  oc_add_resource(res_OnOff_3);
-  PRINT("Register Resource 'InfoOnOff_3' with local path \"%s\"\n", URL_INFOONOFF_3);
-  oc_resource_t *res_InfoOnOff_3 =
-    oc_new_resource("InfoOnOff_3", URL_INFOONOFF_3, 1, 0);
-  oc_resource_bind_resource_type(res_InfoOnOff_3, "urn:knx:dpa.417.51");
-  oc_resource_bind_dpt(res_InfoOnOff_3, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_InfoOnOff_3, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_InfoOnOff_3, OC_IF_S); /* if.s */ 
-  oc_resource_set_function_block_instance(res_InfoOnOff_3, 3); /* instance 3 */ 
-  oc_resource_set_discoverable(res_InfoOnOff_3, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_InfoOnOff_3, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_InfoOnOff_3, true);
-  oc_resource_set_request_handler(res_InfoOnOff_3, OC_GET, get_InfoOnOff_3, NULL);
-  oc_add_resource(res_InfoOnOff_3);
-  PRINT("Register Resource 'OnOff_4' with local path \"%s\"\n", URL_ONOFF_4);
-  oc_resource_t *res_OnOff_4 =
-    oc_new_resource("OnOff_4", URL_ONOFF_4, 1, 0);
-  oc_resource_bind_resource_type(res_OnOff_4, "urn:knx:dpa.417.61");
-  oc_resource_bind_dpt(res_OnOff_4, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_OnOff_4, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_OnOff_4, OC_IF_A); /* if.a */ 
-  oc_resource_set_function_block_instance(res_OnOff_4, 4); /* instance 4 */ 
-  oc_resource_set_discoverable(res_OnOff_4, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_OnOff_4, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_OnOff_4, true);
-  oc_resource_set_request_handler(res_OnOff_4, OC_GET, get_OnOff_4, NULL);
-  oc_resource_set_request_handler(res_OnOff_4, OC_PUT, put_OnOff_4, NULL); 
-  oc_add_resource(res_OnOff_4);
-  PRINT("Register Resource 'InfoOnOff_4' with local path \"%s\"\n", URL_INFOONOFF_4);
-  oc_resource_t *res_InfoOnOff_4 =
-    oc_new_resource("InfoOnOff_4", URL_INFOONOFF_4, 1, 0);
-  oc_resource_bind_resource_type(res_InfoOnOff_4, "urn:knx:dpa.417.51");
-  oc_resource_bind_dpt(res_InfoOnOff_4, "urn:knx:dpt.switch");
-  oc_resource_bind_content_type(res_InfoOnOff_4, APPLICATION_CBOR);
-  oc_resource_bind_resource_interface(res_InfoOnOff_4, OC_IF_S); /* if.s */ 
-  oc_resource_set_function_block_instance(res_InfoOnOff_4, 4); /* instance 4 */ 
-  oc_resource_set_discoverable(res_InfoOnOff_4, true);
-  /* periodic observable
-     to be used when one wants to send an event per time slice
-     period is 1 second */
-  /* oc_resource_set_periodic_observable(res_InfoOnOff_4, 1); */
-  /* set observable
-     events are send when oc_notify_observers(oc_resource_t *resource) is
-    called. this function must be called when the value changes, preferable on
-    an interrupt when something is read from the hardware. */
-  oc_resource_set_observable(res_InfoOnOff_4, true);
-  oc_resource_set_request_handler(res_InfoOnOff_4, OC_GET, get_InfoOnOff_4, NULL);
-  oc_add_resource(res_InfoOnOff_4);
-
+  for (int i = 0; i < g_instances; i++) {
+    app_dp_register_resources(i);
+    /* the progress of the software update of the device */
+    app_swu_register_resource(i);
+  }
+  /* diagnostics: the trace ring of the data point handlers */
+  app_trace_register_resource(0);
+  app_stats_register_resource(0);
 }
 
 /**
@@ -1843,6 +538,9 @@ factory_presets_cb(size_t device_index, void *data)
     PRINT("factory_presets_cb: resetting device\n");
     oc_knx_device_storage_reset(device_index, 2);
   }
+  /* the tables may be cleared: drop the cached lookups */
+  app_got_invalidate();
+  app_meta_invalidate();
 }
 
 /**
@@ -1879,8 +577,25 @@ static oc_event_callback_retval_t send_delayed_response(void *context)
   return OC_EVENT_DONE;
 }
 
+static oc_event_callback_retval_t send_delayed_error_response(void *context)
+{
+  oc_separate_response_t *response = (oc_separate_response_t *)context;
+
+  if (response->active)
+  {
+    oc_set_separate_response_buffer(response);
+    oc_send_separate_response(response, OC_STATUS_INTERNAL_SERVER_ERROR);
+    PRINT_APP("Delayed error response sent\n");
+  }
+
+  return OC_EVENT_DONE;
+}
+
 /**
  * @brief software update callback
+ * the blocks are written to downloaded.bin (device 0) or
+ * downloaded_<device>.bin in the storage folder (per shard),
+ * see knx_iot_virtual_swu.h
  *
  * @param device the device index
  * @param response the instance of an internal struct that is used to track
@@ -1899,15 +614,23 @@ void swu_cb(size_t device,
             size_t len,
             void *data)
 {
-  (void)device;
-  (void)binary_size;
-  char filename[] = "./downloaded.bin";
+  (void)data;
+  char filename[sizeof(g_storage_folder) + 40];
+  if (device > 0) {
+    snprintf(filename, sizeof(filename), "%s/downloaded_%d.bin",
+             g_storage_folder, (int)device);
+  } else {
+    snprintf(filename, sizeof(filename), "%s/downloaded.bin",
+             g_storage_folder);
+  }
   PRINT(" swu_cb %s block=%d size=%d \n", filename, (int)offset, (int)len);
 
-  FILE *write_ptr = fopen("downloaded_bin", "ab");
-  size_t r = fwrite(payload, sizeof(*payload), len, write_ptr);
-  fclose(write_ptr);
-
+  if (app_swu_block(device, filename, binary_size, offset, payload, len) ==
+      APP_SWU_ERROR) {
+    oc_set_delayed_callback(response, &send_delayed_error_response, 0);
+    return;
+  }
+  /* the block is stored (the image is synced when it is complete) */
   oc_set_delayed_callback(response, &send_delayed_response, 0);
 }
 
@@ -1919,21 +642,15 @@ void swu_cb(size_t device,
 void
 initialize_variables(void)
 {
-  /* initialize global variables for resources */
-  /* if wanted read them from persistent storage */
-  //g_OnOff_1 = false;   /**< global variable for OnOff_1 */ 
-  //g_InfoOnOff_1 = false;   /**< global variable for InfoOnOff_1 */ 
-  //g_OnOff_2 = false;   /**< global variable for OnOff_2 */ 
-  //g_InfoOnOff_2 = false;   /**< global variable for InfoOnOff_2 */ 
-  //g_OnOff_3 = false;   /**< global variable for OnOff_3 */ 
-  //g_InfoOnOff_3 = false;   /**< global variable for InfoOnOff_3 */ 
-  //g_OnOff_4 = false;   /**< global variable for OnOff_4 */ 
-  //g_InfoOnOff_4 = false;   /**< global variable for InfoOnOff_4 */ 
-  /* parameter variables */
-  uint8_t oc_storage_buf[32];
-  long ret;
-  bool err;
+  /* build the url index of the data points */
+  app_dp_registry_init(g_app_dp, (int)(sizeof(g_app_dp) / sizeof(g_app_dp[0])));
+  for (int i = 0; i < g_instances; i++) {
+    app_state_init(app_state_store(i));
+  }
 
+  /* the values of the resources are kept in the state store, restored from
+     the journal in the storage folder (discarded on reset) */
+  app_journal_open(g_storage_folder, g_instances, g_reset == false);
 }
 
 int app_set_serial_number(char* serial_number)
@@ -1942,6 +659,26 @@ int app_set_serial_number(char* serial_number)
   return 0;
 }
 
+int app_set_instances(int instances)
+{
+  if (instances < 1 || instances > APP_MAX_DEVICES) {
+    PRINT("app_set_instances: %d not in range [1..%d]\n", instances,
+          APP_MAX_DEVICES);
+    return -1;
+  }
+  g_instances = instances;
+  return 0;
+}
+
+int app_set_storage_folder(const char *folder)
+{
+  if (folder == NULL || strlen(folder) + 20 > sizeof(g_storage_folder)) {
+    return -1;
+  }
+  g_storage_base = folder;
+  return 0;
+}
+
 int app_initialize_stack()
 {
   int init;
@@ -1967,9 +704,21 @@ int app_initialize_stack()
   sprintf(storage,"./knx_iot_virtual_sa_%s",g_serial_number);  
   PRINT("\tstorage at '%s' \n",storage);
   oc_storage_config(storage);
+  strncpy(g_storage_folder, storage, sizeof(g_storage_folder) - 1);
 #else
-  PRINT("\tstorage at 'knx_iot_virtual_sa_creds' \n");
-  oc_storage_config("./knx_iot_virtual_sa_creds");
+  if (g_shard.index >= 0) {
+    /* each shard has its own storage */
+    char storage[400];
+    app_shard_storage(g_storage_base, g_shard.index, storage,
+                      sizeof(storage));
+    PRINT("\tstorage at '%s' \n", storage);
+    oc_storage_config(storage);
+    strncpy(g_storage_folder, storage, sizeof(g_storage_folder) - 1);
+  } else {
+    PRINT("\tstorage at '%s' \n", g_storage_base);
+    oc_storage_config(g_storage_base);
+    strcpy(g_storage_folder, g_storage_base);
+  }
 #endif
   
 
@@ -1995,6 +744,8 @@ int app_initialize_stack()
     PRINT("oc_main_init failed %d, exiting.\n", init);
     return init;
   }
+  /* write the changes of the data points behind */
+  app_journal_start();
 
 #ifdef OC_OSCORE
   PRINT("OSCORE - Enabled\n");
@@ -2027,6 +778,9 @@ signal_event_loop(void)
 #ifndef NO_MAIN
   WakeConditionVariable(&cv);
 #endif /* NO_MAIN */
+  if (app_wakeup) {
+    app_wakeup();
+  }
 }
 #endif /* WIN32 */
 
@@ -2043,6 +797,9 @@ signal_event_loop(void)
   pthread_cond_signal(&cv);
   pthread_mutex_unlock(&mutex);
 #endif /* NO_MAIN */
+  if (app_wakeup) {
+    app_wakeup();
+  }
 }
 #endif /* __linux__ */
 
@@ -2061,6 +818,20 @@ handle_signal(int signal)
   quit = 1;
 }
 
+#ifdef __linux__
+/**
+ * @brief dump the trace ring and the stats on stdout (SIGUSR1)
+ * @param signal the captured signal
+ */
+static void
+handle_trace_signal(int signal)
+{
+  (void)signal;
+  app_trace_dump_fd(STDOUT_FILENO);
+  app_stats_dump_fd(STDOUT_FILENO);
+}
+#endif
+
 /**
  * @brief print usage and quits
  *
@@ -2073,6 +844,16 @@ print_usage()
   PRINT("-help  : this message\n");
   PRINT("reset  : does an full reset of the device\n");
   PRINT("-s <serial number> : sets the serial number of the device\n");
+  PRINT("--instances <N> : runs N devices (instances) in this process\n");
+  PRINT("--serial-base <serial number> : serial number of the first instance,\n");
+  PRINT("      the other instances use the next serial numbers\n");
+  PRINT("--shards <K> : (Linux) runs the instances in K processes\n");
+  PRINT("--pin-cpu : (Linux) pins each shard on its own cpu\n");
+  PRINT("--smode-window <seconds> : collects the s-mode messages for the\n");
+  PRINT("      given time before sending them (default 0: per poll)\n");
+  PRINT("--scopes <link|site|both|2,5> : multicast scopes of the s-mode\n");
+  PRINT("      messages sent by the application (default both)\n");
+  PRINT("--bench-log <file> : logs each data point change with the time in ns\n");
   exit(0);
 }
 /**
@@ -2107,6 +888,9 @@ main(int argc, char *argv[])
   sa.sa_handler = handle_signal;
   /* install Ctrl-C */
   sigaction(SIGINT, &sa, NULL);
+  /* kill -USR1 dumps the trace ring */
+  sa.sa_handler = handle_trace_signal;
+  sigaction(SIGUSR1, &sa, NULL);
 #endif
 
   for (int i = 0; i < argc; i++) {
@@ -2128,14 +912,77 @@ main(int argc, char *argv[])
         app_set_serial_number(argv[2]);
      }
   }
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--instances") == 0) {
+      // number of devices in this process
+      PRINT("instances %s\n", argv[i + 1]);
+      app_set_instances(atoi(argv[i + 1]));
+    }
+    if (strcmp(argv[i], "--serial-base") == 0) {
+      // serial number of the first instance
+      PRINT("serial number base %s\n", argv[i + 1]);
+      app_set_serial_number(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--shards") == 0) {
+      // number of processes running the instances
+      PRINT("shards %s\n", argv[i + 1]);
+      g_shards = atoi(argv[i + 1]);
+    }
+    if (strcmp(argv[i], "--smode-window") == 0) {
+      // batch window of the s-mode messages
+      PRINT("s-mode window %s\n", argv[i + 1]);
+      app_smode_set_window((uint16_t)atoi(argv[i + 1]));
+    }
+    if (strcmp(argv[i], "--scopes") == 0) {
+      // scope policy of the s-mode messages
+      uint16_t scopes;
+      if (app_smode_parse_scopes(argv[i + 1], &scopes) != 0) {
+        print_usage();
+      }
+      PRINT("scopes %s\n", argv[i + 1]);
+      app_smode_set_scopes(scopes);
+    }
+    if (strcmp(argv[i], "--bench-log") == 0) {
+      // log of the data point changes (switch latency benchmark)
+      PRINT("bench log %s\n", argv[i + 1]);
+      g_bench_log = argv[i + 1];
+    }
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--pin-cpu") == 0) {
+      g_pin_cpu = true;
+    }
+  }
+#ifdef __linux__
+  if (g_shards > 1 || g_pin_cpu) {
+    /* the stack runs one event loop per process: run the shards as processes,
+       each with its own slice of the instances and serial numbers */
+    int ret = app_shard_fork(g_shards, g_instances, g_pin_cpu, &g_shard);
+    if (ret != 0) {
+      /* main process: all shards have stopped, fails if the fork or a shard
+         failed */
+      return (ret == 1) ? 0 : 1;
+    }
+    char serial_number[20];
+    app_shard_serial_number(g_serial_number, g_shard.first, serial_number,
+                            sizeof(serial_number));
+    app_set_serial_number(serial_number);
+    app_set_instances(g_shard.count);
+  }
+#endif
 
   /* do all initialization */
   app_initialize_stack();
+  if (g_bench_log != NULL && app_bench_log_open(g_bench_log) != 0) {
+    return 1;
+  }
 
 #ifdef WIN32
   /* windows specific loop */
   while (quit != 1) {
     next_event = oc_main_poll();
+    app_got_check_load_state();
+    app_meta_check_load_state();
     if (next_event == 0) {
       SleepConditionVariableCS(&cv, &cs, INFINITE);
     } else {
@@ -2151,7 +998,22 @@ main(int argc, char *argv[])
 #ifdef __linux__
   /* Linux specific loop */
   while (quit != 1) {
-    next_event = oc_main_poll();
+    if (g_shard.index >= 0) {
+      uint64_t start = app_shard_time_ns();
+      next_event = oc_main_poll();
+      app_shard_poll_done(app_shard_time_ns() - start,
+                          app_dp_request_count());
+      if (next_event == 0) {
+        /* wake up for the stats report */
+        next_event =
+          oc_clock_time() + APP_SHARD_REPORT_INTERVAL * OC_CLOCK_SECOND;
+      }
+    } else {
+      next_event = oc_main_poll();
+    }
+    /* the tables can be rewritten while loading */
+    app_got_check_load_state();
+    app_meta_check_load_state();
     pthread_mutex_lock(&mutex);
     if (next_event == 0) {
       pthread_cond_wait(&cv, &mutex);
@@ -2166,6 +1028,9 @@ main(int argc, char *argv[])
 
   /* shut down the stack */
   oc_main_shutdown();
+  app_swu_shutdown();
+  app_journal_close();
+  app_bench_log_close();
   return 0;
 }
 #endif /* NO_MAIN */
@@ -66,11 +66,31 @@ typedef struct oc_put_struct_t
 
 /**
  * @brief set the put callback (on application level)
+ * the callback is a subscription to all data points of the notifications
+ * (knx_iot_virtual_notify.h), which also provide the data point id, the
+ * old and new value and the source of the change.
  * 
  * @param cb the callback
  */
 void app_set_put_cb(oc_put_cb_t cb);
 
+/**
+ * Callback invoked when the event loop is signalled (signal_event_loop),
+ * e.g. a message was received or a callback was scheduled
+ */
+typedef void (*app_wakeup_cb_t)(void);
+
+/**
+ * @brief set the wakeup callback (on application level)
+ * used by applications that run oc_main_poll themselves (NO_MAIN).
+ * the callback is called from the thread that signals the event loop
+ * (e.g. the network thread of the stack), so it should only schedule
+ * the oc_main_poll call on the thread that runs the event loop.
+ *
+ * @param cb the callback
+ */
+void app_set_wakeup_cb(app_wakeup_cb_t cb);
+
 /**
  * @brief initialize the stack
  * 
@@ -87,6 +107,26 @@ int app_initialize_stack();
  */
 int app_set_serial_number(char* serial_number);
 
+/**
+ * @brief sets the number of devices (instances) hosted by this process
+ * the instances use consecutive serial numbers, starting at the serial number
+ * should be called before app_initialize_stack()
+ *
+ * @param instances the number of instances
+ * @return int 0 == success
+ */
+int app_set_instances(int instances);
+
+/**
+ * @brief sets the storage folder of the stack (Linux)
+ * default ./knx_iot_virtual_sa_creds, the folder must exist
+ * should be called before app_initialize_stack()
+ *
+ * @param folder the storage folder
+ * @return int 0 == success
+ */
+int app_set_storage_folder(const char *folder);
+
 
 // Getters/Setters for bool
 /**
@@ -0,0 +1,242 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * sharding of the virtual devices over several cores (processes)
+ */
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "knx_iot_virtual_shard.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+/**
+ * @brief the stats of the shard, since the last report
+ */
+typedef struct app_shard_stats_t
+{
+  int index;              /**< the shard index, -1 == not sharded */
+  uint64_t report_ns;     /**< time of the last report */
+  uint32_t requests;      /**< requests at the time of the last report */
+  uint64_t polls;         /**< poll calls since the last report */
+  uint64_t poll_total_ns; /**< total poll duration since the last report */
+  uint64_t poll_max_ns;   /**< max poll duration since the last report */
+} app_shard_stats_t;
+
+static app_shard_stats_t g_shard_stats = { -1, 0, 0, 0, 0, 0 };
+
+#ifdef __linux__
+static pid_t g_shard_pids[1024]; /**< the pids of the shards */
+static int g_shard_count = 0;    /**< the number of shards */
+
+/**
+ * @brief forwards the signal (e.g. Ctrl-C) to the shards
+ */
+static void
+app_shard_forward_signal(int signal)
+{
+  int i;
+  for (i = 0; i < g_shard_count; i++) {
+    kill(g_shard_pids[i], signal);
+  }
+}
+#endif /* __linux__ */
+
+uint64_t
+app_shard_time_ns(void)
+{
+#ifdef __linux__
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#elif defined(WIN32)
+  LARGE_INTEGER count;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((double)count.QuadPart * 1.e9 /
+                    (double)frequency.QuadPart);
+#else
+  return 0;
+#endif
+}
+
+int
+app_shard_fork(int shards, int instances, bool pin_cpu, app_shard_t *shard)
+{
+#ifdef __linux__
+  int per_shard;
+  int remainder;
+  int first = 0;
+  bool failed = false;
+  int i;
+
+  if (shard == NULL || shards < 1 || shards > instances ||
+      shards > (int)(sizeof(g_shard_pids) / sizeof(g_shard_pids[0]))) {
+    fprintf(stderr, "app_shard_fork: invalid number of shards %d\n", shards);
+    return -1;
+  }
+  per_shard = instances / shards;
+  remainder = instances % shards;
+
+  for (i = 0; i < shards; i++) {
+    int count = per_shard + ((i < remainder) ? 1 : 0);
+    pid_t pid = fork();
+    if (pid < 0) {
+      fprintf(stderr, "app_shard_fork: fork failed %d\n", errno);
+      app_shard_forward_signal(SIGINT);
+      failed = true;
+      break;
+    }
+    if (pid == 0) {
+      /* the shard */
+      shard->index = i;
+      shard->first = first;
+      shard->count = count;
+      g_shard_stats.index = i;
+      g_shard_stats.report_ns = app_shard_time_ns();
+      if (pin_cpu) {
+        cpu_set_t set;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        CPU_ZERO(&set);
+        CPU_SET((int)(i % (cpus > 0 ? cpus : 1)), &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+          fprintf(stderr, "shard %d: pinning failed %d\n", i, errno);
+        }
+      }
+      printf("shard %d: instances %d..%d (pid %d)\n", i, first,
+             first + count - 1, (int)getpid());
+      return 0;
+    }
+    g_shard_pids[g_shard_count++] = pid;
+    first += count;
+  }
+
+  /* the main process: wait for all shards */
+  struct sigaction sa;
+  sigfillset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  sa.sa_handler = app_shard_forward_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  for (i = 0; i < g_shard_count; i++) {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(g_shard_pids[i], &status, 0)) < 0 && errno == EINTR) {
+    }
+    if (pid < 0) {
+      fprintf(stderr, "app_shard_fork: shard %d: wait failed %d\n", i, errno);
+      failed = true;
+    } else if (WIFSIGNALED(status)) {
+      fprintf(stderr, "app_shard_fork: shard %d: killed by signal %d\n", i,
+              WTERMSIG(status));
+      failed = true;
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "app_shard_fork: shard %d: exit status %d\n", i,
+              WEXITSTATUS(status));
+      failed = true;
+    }
+  }
+  shard->index = -1;
+  return failed ? -1 : 1;
+#else
+  (void)shards;
+  (void)instances;
+  (void)pin_cpu;
+  (void)shard;
+  fprintf(stderr, "app_shard_fork: sharding is only supported on Linux\n");
+  return -1;
+#endif /* __linux__ */
+}
+
+void
+app_shard_serial_number(const char *base, int offset, char *serial_number,
+                        size_t len)
+{
+  unsigned long long serial = strtoull(base, NULL, 16);
+  if (offset == 0) {
+    strncpy(serial_number, base, len);
+    serial_number[len - 1] = '\0';
+    return;
+  }
+  snprintf(serial_number, len, "%0*llX", (int)strlen(base),
+           serial + (unsigned long long)offset);
+}
+
+int
+app_shard_storage(const char *base, int shard, char *folder, size_t len)
+{
+  snprintf(folder, len, "%s/shard_%d", base, shard);
+#ifdef __linux__
+  if (mkdir(base, 0755) != 0 && errno != EEXIST) {
+    return -1;
+  }
+  if (mkdir(folder, 0755) != 0 && errno != EEXIST) {
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+void
+app_shard_poll_done(uint64_t poll_ns, uint32_t requests)
+{
+  app_shard_stats_t *stats = &g_shard_stats;
+  uint64_t now;
+
+  stats->polls++;
+  stats->poll_total_ns += poll_ns;
+  if (poll_ns > stats->poll_max_ns) {
+    stats->poll_max_ns = poll_ns;
+  }
+  now = app_shard_time_ns();
+  if (now - stats->report_ns < APP_SHARD_REPORT_INTERVAL * 1000000000ull) {
+    return;
+  }
+  double seconds = (double)(now - stats->report_ns) / 1.e9;
+  printf("shard %d: %.1f req/s, %llu polls, poll avg %.1f us, max %.1f us\n",
+         stats->index, (double)(requests - stats->requests) / seconds,
+         (unsigned long long)stats->polls,
+         (double)stats->poll_total_ns / (double)stats->polls / 1000.,
+         (double)stats->poll_max_ns / 1000.);
+  stats->report_ns = now;
+  stats->requests = requests;
+  stats->polls = 0;
+  stats->poll_total_ns = 0;
+  stats->poll_max_ns = 0;
+}
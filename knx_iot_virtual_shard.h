@@ -0,0 +1,116 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * sharding of the virtual devices over several cores.
+ *
+ * The stack keeps its state in globals (one event loop, one set of tables
+ * per process), so oc_main_poll can not run on several threads at once.
+ * A shard is therefore a process: the main process forks one child per
+ * shard, each child runs its own event loop and sockets for a slice of the
+ * instances, optionally pinned on its own cpu.
+ * Each shard reports its requests/s and poll latency periodically.
+ * Sharding is only available on Linux.
+ */
+#ifndef KNX_IOT_VIRTUAL_SHARD_H
+#define KNX_IOT_VIRTUAL_SHARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SHARD_REPORT_INTERVAL 10 /**< seconds between the stats reports */
+
+/**
+ * @brief the slice of the instances that is run by a shard
+ */
+typedef struct app_shard_t
+{
+  int index; /**< the shard index, -1 == not sharded */
+  int first; /**< the first instance of the shard */
+  int count; /**< the number of instances of the shard */
+} app_shard_t;
+
+/**
+ * @brief fork the shards
+ * in the main process the function returns when all shards have stopped.
+ * When a fork fails, the shards that were started are stopped (SIGINT) and
+ * reaped before returning.
+ *
+ * @param shards the number of shards
+ * @param instances the total number of instances
+ * @param pin_cpu pin each shard on cpu (shard index % number of cpus)
+ * @param shard the slice of the calling shard
+ * @return 0 in a shard (child), 1 in the main process when all shards
+ * exited with status 0, -1 on error (invalid arguments, fork failure, or a
+ * shard that failed or was killed)
+ */
+int app_shard_fork(int shards, int instances, bool pin_cpu,
+                   app_shard_t *shard);
+
+/**
+ * @brief create the serial number of an instance
+ * the serial number base (hex) is incremented with the offset, the length
+ * of the base is kept (leading zeros)
+ *
+ * @param base the serial number of the first instance
+ * @param offset the offset of the instance
+ * @param serial_number the serial number (output)
+ * @param len the size of serial_number
+ */
+void app_shard_serial_number(const char *base, int offset, char *serial_number,
+                             size_t len);
+
+/**
+ * @brief create (if needed) the storage folder of the shard
+ *
+ * @param base the storage folder of the application
+ * @param shard the shard index
+ * @param folder the storage folder of the shard (output)
+ * @param len the size of folder
+ * @return int 0 == success
+ */
+int app_shard_storage(const char *base, int shard, char *folder, size_t len);
+
+/**
+ * @brief account one oc_main_poll call of the shard
+ * reports the stats every APP_SHARD_REPORT_INTERVAL seconds
+ *
+ * @param poll_ns the duration of the oc_main_poll call in nanoseconds
+ * @param requests the total number of requests handled so far
+ */
+void app_shard_poll_done(uint64_t poll_ns, uint32_t requests);
+
+/**
+ * @brief monotonic time in nanoseconds, for measuring the poll duration
+ *
+ * @return the time in nanoseconds
+ */
+uint64_t app_shard_time_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_SHARD_H */
@@ -0,0 +1,179 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * batched s-mode emission
+ *
+ * The queued data points are kept as a scope set per data point id, the
+ * batch is sent from a delayed callback of the stack. The s-mode api of the
+ * stack takes one url per message: a KNX s-mode message carries the value
+ * of one group object, so the batch reduces the messages to one per data
+ * point and scope, but does not combine data points in one message.
+ * The message is encoded by the stack for each scope (the s-mode api has no
+ * pre-encoded variant), with one scope policy this is one encode per press.
+ */
+#include "knx_iot_virtual_smode.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_stats.h"
+
+#include "oc_api.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t g_smode_scopes[APP_DP_MAX]; /**< queued scopes per data point */
+static uint16_t g_smode_pending = 0;      /**< union of the queued scopes */
+static uint16_t g_smode_window = 0;       /**< batch window in seconds */
+static bool g_smode_scheduled = false;    /**< the batch is scheduled */
+static uint32_t g_smode_sent = 0;         /**< s-mode messages sent */
+static uint16_t g_smode_policy = 0;       /**< scope policy, 0 == not set */
+
+/**
+ * @brief delayed callback of the stack: send the batch
+ */
+static oc_event_callback_retval_t
+app_smode_batch_cb(void *data)
+{
+  (void)data;
+  g_smode_scheduled = false;
+  app_smode_flush();
+  return OC_EVENT_DONE;
+}
+
+int
+app_smode_parse_scopes(const char *text, uint16_t *scopes)
+{
+  uint16_t set = 0;
+  char *end;
+  long scope;
+
+  if (text == NULL || scopes == NULL) {
+    return -1;
+  }
+  if (strcmp(text, "link") == 0) {
+    set = APP_SMODE_SCOPE(APP_SMODE_SCOPE_LINK);
+  } else if (strcmp(text, "site") == 0) {
+    set = APP_SMODE_SCOPE(APP_SMODE_SCOPE_SITE);
+  } else if (strcmp(text, "both") == 0) {
+    set = APP_SMODE_SCOPES_DEFAULT;
+  } else {
+    while (*text != '\0') {
+      scope = strtol(text, &end, 10);
+      if (end == text || scope < 0 || scope > APP_SMODE_MAX_SCOPE) {
+        return -1;
+      }
+      set |= APP_SMODE_SCOPE(scope);
+      text = (*end == ',') ? end + 1 : end;
+      if (*end != ',' && *end != '\0') {
+        return -1;
+      }
+    }
+  }
+  if (set == 0) {
+    return -1;
+  }
+  *scopes = set;
+  return 0;
+}
+
+void
+app_smode_set_scopes(uint16_t scopes)
+{
+  g_smode_policy = scopes;
+}
+
+uint16_t
+app_smode_scopes(void)
+{
+  if (g_smode_policy == 0) {
+    const char *env = getenv("KNX_IOT_SCOPES");
+    if (env == NULL || app_smode_parse_scopes(env, &g_smode_policy) != 0) {
+      if (env != NULL) {
+        PRINT("invalid KNX_IOT_SCOPES '%s', using link and site\n", env);
+      }
+      g_smode_policy = APP_SMODE_SCOPES_DEFAULT;
+    }
+  }
+  return g_smode_policy;
+}
+
+void
+app_smode_set_window(uint16_t seconds)
+{
+  g_smode_window = seconds;
+}
+
+void
+app_smode_queue(int id, uint16_t scopes)
+{
+  if (id < 0 || id >= APP_DP_MAX || scopes == 0) {
+    return;
+  }
+  g_smode_scopes[id] |= scopes;
+  g_smode_pending |= scopes;
+  if (g_smode_scheduled == false) {
+    g_smode_scheduled = true;
+    oc_set_delayed_callback(NULL, app_smode_batch_cb, g_smode_window);
+  }
+}
+
+int
+app_smode_queue_url(const char *url, uint16_t scopes)
+{
+  const app_dp_t *dp = app_dp_find(url);
+  if (dp == NULL) {
+    return -1;
+  }
+  app_smode_queue(app_dp_index(dp), scopes);
+  return 0;
+}
+
+void
+app_smode_flush(void)
+{
+  uint16_t pending = g_smode_pending;
+  int count = app_dp_count();
+  int scope;
+  int id;
+
+  g_smode_pending = 0;
+  for (scope = 0; scope <= APP_SMODE_MAX_SCOPE && pending != 0; scope++) {
+    if ((pending & APP_SMODE_SCOPE(scope)) == 0) {
+      continue;
+    }
+    pending &= (uint16_t)~APP_SMODE_SCOPE(scope);
+    for (id = 0; id < count; id++) {
+      if (g_smode_scopes[id] & APP_SMODE_SCOPE(scope)) {
+        g_smode_scopes[id] &= (uint16_t)~APP_SMODE_SCOPE(scope);
+        APP_TRACE(APP_TRACE_S_MODE, 0, id, (uint8_t)scope, 0);
+        oc_do_s_mode_with_scope(scope, (char *)app_dp_get(id)->url, "w");
+        app_stats_s_mode(id);
+        g_smode_sent++;
+      }
+    }
+  }
+}
+
+uint32_t
+app_smode_sent_count(void)
+{
+  return g_smode_sent;
+}
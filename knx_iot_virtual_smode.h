@@ -0,0 +1,130 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * batched s-mode emission, shared by the virtual applications.
+ *
+ * Instead of sending an s-mode message for each change, the data points to
+ * send are marked (per scope) and sent together at the end of the batch
+ * window: by default the current poll of the stack, optionally a number of
+ * seconds. A data point changed several times within the window is sent
+ * once, with its latest value (the stack reads the value when sending).
+ * The messages are sent per scope: first all data points of the lowest
+ * scope, then the next scope.
+ * The scopes used for the application's own messages (e.g. a push button)
+ * are a runtime policy: link-local (2), site-local (5) or both (default),
+ * set with --scopes or with the environment variable KNX_IOT_SCOPES.
+ * All functions are called from the stack thread.
+ */
+#ifndef KNX_IOT_VIRTUAL_SMODE_H
+#define KNX_IOT_VIRTUAL_SMODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SMODE_MAX_SCOPE 15 /**< highest multicast scope */
+
+/**
+ * @brief the bit of a multicast scope in a scope set
+ * e.g. APP_SMODE_SCOPE(2) | APP_SMODE_SCOPE(5)
+ */
+#define APP_SMODE_SCOPE(scope) ((uint16_t)(1u << (scope)))
+
+#define APP_SMODE_SCOPE_LINK 2 /**< link-local multicast scope */
+#define APP_SMODE_SCOPE_SITE 5 /**< site-local multicast scope */
+
+/**
+ * @brief the default scope policy: link-local and site-local
+ */
+#define APP_SMODE_SCOPES_DEFAULT                                               \
+  (APP_SMODE_SCOPE(APP_SMODE_SCOPE_LINK) | APP_SMODE_SCOPE(APP_SMODE_SCOPE_SITE))
+
+/**
+ * @brief parse a scope policy
+ *
+ * @param text "link", "site", "both" or a comma separated list of scopes
+ * (e.g. "2,5")
+ * @param scopes the scope set (output)
+ * @return int 0 == success, -1 invalid policy
+ */
+int app_smode_parse_scopes(const char *text, uint16_t *scopes);
+
+/**
+ * @brief set the scope policy of the application's own messages
+ * the environment variable KNX_IOT_SCOPES (app_smode_parse_scopes) is read
+ * once when no policy is set
+ *
+ * @param scopes the set of scopes (APP_SMODE_SCOPE), 0 == default
+ */
+void app_smode_set_scopes(uint16_t scopes);
+
+/**
+ * @brief the scope policy of the application's own messages
+ *
+ * @return the set of scopes (APP_SMODE_SCOPE)
+ */
+uint16_t app_smode_scopes(void);
+
+/**
+ * @brief set the batch window
+ *
+ * @param seconds 0 == send at the end of the current poll (default),
+ * otherwise the number of seconds after the first queued data point
+ */
+void app_smode_set_window(uint16_t seconds);
+
+/**
+ * @brief queue an s-mode message (flag "w") of a data point
+ *
+ * @param id the data point id
+ * @param scopes the set of scopes to send to (APP_SMODE_SCOPE)
+ */
+void app_smode_queue(int id, uint16_t scopes);
+
+/**
+ * @brief queue an s-mode message (flag "w") of a data point by url
+ *
+ * @param url the url of the data point
+ * @param scopes the set of scopes to send to (APP_SMODE_SCOPE)
+ * @return int 0 == queued, -1 the url is not a data point
+ */
+int app_smode_queue_url(const char *url, uint16_t scopes);
+
+/**
+ * @brief send all queued s-mode messages now
+ */
+void app_smode_flush(void);
+
+/**
+ * @brief the number of s-mode messages sent (one per data point and scope)
+ *
+ * @return the number of messages
+ */
+uint32_t app_smode_sent_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_SMODE_H */
@@ -0,0 +1,219 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * data point state store
+ *
+ * The atomics are the compiler builtins (gcc/clang) or the Interlocked
+ * functions (msvc), the code is compiled as C89/C99 on all platforms.
+ * A snapshot retries when the generation changed during the copy.
+ */
+#include "knx_iot_virtual_state.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#define APP_ATOMIC_LOAD(p) ((uint32_t)InterlockedOr((volatile LONG *)(p), 0))
+#define APP_ATOMIC_OR(p, v)                                                    \
+  ((uint32_t)InterlockedOr((volatile LONG *)(p), (LONG)(v)))
+#define APP_ATOMIC_AND(p, v)                                                   \
+  ((uint32_t)InterlockedAnd((volatile LONG *)(p), (LONG)(v)))
+#define APP_ATOMIC_XOR(p, v)                                                   \
+  ((uint32_t)InterlockedXor((volatile LONG *)(p), (LONG)(v)))
+#define APP_ATOMIC_XCHG(p, v)                                                  \
+  ((uint32_t)InterlockedExchange((volatile LONG *)(p), (LONG)(v)))
+#define APP_ATOMIC_INC(p) ((uint32_t)InterlockedIncrement((volatile LONG *)(p)))
+#else
+#define APP_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define APP_ATOMIC_OR(p, v) __atomic_fetch_or((p), (v), __ATOMIC_ACQ_REL)
+#define APP_ATOMIC_AND(p, v) __atomic_fetch_and((p), (v), __ATOMIC_ACQ_REL)
+#define APP_ATOMIC_XOR(p, v) __atomic_fetch_xor((p), (v), __ATOMIC_ACQ_REL)
+#define APP_ATOMIC_XCHG(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define APP_ATOMIC_INC(p) __atomic_add_fetch((p), 1, __ATOMIC_ACQ_REL)
+#endif
+
+#define APP_STATE_WORD(id) ((id) / APP_STATE_WORD_BITS)
+#define APP_STATE_MASK(id) (1u << ((id) % APP_STATE_WORD_BITS))
+
+static app_state_t g_app_state[APP_MAX_DEVICES]; /**< store per device */
+
+/**
+ * @brief check if the data point id fits in the store
+ */
+static bool
+app_state_valid(int id)
+{
+  return (id >= 0 && id < APP_DP_MAX);
+}
+
+/**
+ * @brief mark the data point as changed
+ */
+static void
+app_state_changed(app_state_t *state, int id)
+{
+  APP_ATOMIC_OR(&state->dirty[APP_STATE_WORD(id)], APP_STATE_MASK(id));
+  APP_ATOMIC_INC(&state->generation);
+}
+
+app_state_t *
+app_state_store(size_t device)
+{
+  if (device >= APP_MAX_DEVICES) {
+    return NULL;
+  }
+  return &g_app_state[device];
+}
+
+void
+app_state_init(app_state_t *state)
+{
+  int i;
+  for (i = 0; i < APP_STATE_WORDS; i++) {
+    APP_ATOMIC_XCHG(&state->value[i], 0);
+    APP_ATOMIC_XCHG(&state->fault[i], 0);
+    APP_ATOMIC_XCHG(&state->dirty[i], 0);
+  }
+  APP_ATOMIC_INC(&state->generation);
+}
+
+bool
+app_state_get(app_state_t *state, int id)
+{
+  if (app_state_valid(id) == false) {
+    return false;
+  }
+  return (APP_ATOMIC_LOAD(&state->value[APP_STATE_WORD(id)]) &
+          APP_STATE_MASK(id)) != 0;
+}
+
+bool
+app_state_set(app_state_t *state, int id, bool value)
+{
+  uint32_t old;
+  if (app_state_valid(id) == false) {
+    return false;
+  }
+  if (value) {
+    old = APP_ATOMIC_OR(&state->value[APP_STATE_WORD(id)], APP_STATE_MASK(id));
+  } else {
+    old =
+      APP_ATOMIC_AND(&state->value[APP_STATE_WORD(id)], ~APP_STATE_MASK(id));
+  }
+  if (((old & APP_STATE_MASK(id)) != 0) != value) {
+    app_state_changed(state, id);
+  }
+  return (old & APP_STATE_MASK(id)) != 0;
+}
+
+bool
+app_state_test_and_set(app_state_t *state, int id)
+{
+  return app_state_set(state, id, true);
+}
+
+bool
+app_state_toggle(app_state_t *state, int id)
+{
+  uint32_t old;
+  if (app_state_valid(id) == false) {
+    return false;
+  }
+  old = APP_ATOMIC_XOR(&state->value[APP_STATE_WORD(id)], APP_STATE_MASK(id));
+  app_state_changed(state, id);
+  return (old & APP_STATE_MASK(id)) == 0;
+}
+
+bool
+app_state_get_fault(app_state_t *state, int id)
+{
+  if (app_state_valid(id) == false) {
+    return false;
+  }
+  return (APP_ATOMIC_LOAD(&state->fault[APP_STATE_WORD(id)]) &
+          APP_STATE_MASK(id)) != 0;
+}
+
+bool
+app_state_set_fault(app_state_t *state, int id, bool fault)
+{
+  uint32_t old;
+  if (app_state_valid(id) == false) {
+    return false;
+  }
+  if (fault) {
+    old = APP_ATOMIC_OR(&state->fault[APP_STATE_WORD(id)], APP_STATE_MASK(id));
+  } else {
+    old =
+      APP_ATOMIC_AND(&state->fault[APP_STATE_WORD(id)], ~APP_STATE_MASK(id));
+  }
+  if (((old & APP_STATE_MASK(id)) != 0) != fault) {
+    app_state_changed(state, id);
+  }
+  return (old & APP_STATE_MASK(id)) != 0;
+}
+
+uint32_t
+app_state_generation(app_state_t *state)
+{
+  return APP_ATOMIC_LOAD(&state->generation);
+}
+
+void
+app_state_snapshot(app_state_t *state, app_state_snapshot_t *snapshot)
+{
+  uint32_t generation;
+  int i;
+  do {
+    generation = APP_ATOMIC_LOAD(&state->generation);
+    for (i = 0; i < APP_STATE_WORDS; i++) {
+      snapshot->value[i] = APP_ATOMIC_LOAD(&state->value[i]);
+      snapshot->fault[i] = APP_ATOMIC_LOAD(&state->fault[i]);
+    }
+  } while (generation != APP_ATOMIC_LOAD(&state->generation));
+  snapshot->generation = generation;
+}
+
+bool
+app_state_diff(const app_state_snapshot_t *older,
+               const app_state_snapshot_t *newer, uint32_t *changed)
+{
+  uint32_t any = 0;
+  int i;
+  for (i = 0; i < APP_STATE_WORDS; i++) {
+    changed[i] = (older->value[i] ^ newer->value[i]) |
+                 (older->fault[i] ^ newer->fault[i]);
+    any |= changed[i];
+  }
+  return any != 0;
+}
+
+bool
+app_state_take_dirty(app_state_t *state, uint32_t *dirty)
+{
+  uint32_t any = 0;
+  int i;
+  for (i = 0; i < APP_STATE_WORDS; i++) {
+    dirty[i] = APP_ATOMIC_XCHG(&state->dirty[i], 0);
+    any |= dirty[i];
+  }
+  return any != 0;
+}
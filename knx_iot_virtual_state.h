@@ -0,0 +1,200 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * data point state store, shared by the virtual applications.
+ *
+ * The value, fault and dirty state of the data points are stored as bitsets,
+ * indexed by the data point id (the index in the data point table).
+ * All access is atomic, so the stack, the GUI and the Python (Pi) threads
+ * can share the store without locks.
+ * Each change increments the generation counter of the store, which allows
+ * the readers to detect changes with a single compare, and to find the
+ * changed data points with a few word operations (snapshot + diff).
+ */
+#ifndef KNX_IOT_VIRTUAL_STATE_H
+#define KNX_IOT_VIRTUAL_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "knx_iot_virtual_dp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_STATE_WORD_BITS 32 /**< bits per word of the bitsets */
+#define APP_STATE_WORDS                                                        \
+  ((APP_DP_MAX + APP_STATE_WORD_BITS - 1) / APP_STATE_WORD_BITS)
+
+#ifdef _MSC_VER
+#define APP_STATE_ALIGNED __declspec(align(64))
+#else
+#define APP_STATE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+/**
+ * @brief checks if the bit of data point id is set in a bitset
+ */
+#define APP_STATE_BIT(words, id)                                               \
+  ((((words)[(id) / APP_STATE_WORD_BITS]) >> ((id) % APP_STATE_WORD_BITS)) & 1u)
+
+/**
+ * @brief the state store
+ * value and fault share the first cache line (for APP_DP_MAX <= 256),
+ * the dirty bits and the generation counter are written on every change and
+ * are kept on their own cache line.
+ */
+typedef struct app_state_t
+{
+  APP_STATE_ALIGNED uint32_t value[APP_STATE_WORDS]; /**< the values */
+  uint32_t fault[APP_STATE_WORDS];                   /**< the fault states */
+  APP_STATE_ALIGNED uint32_t dirty[APP_STATE_WORDS]; /**< changed, not taken */
+  uint32_t generation; /**< incremented on each change */
+} app_state_t;
+
+/**
+ * @brief snapshot of the state store
+ */
+typedef struct app_state_snapshot_t
+{
+  uint32_t value[APP_STATE_WORDS]; /**< the values */
+  uint32_t fault[APP_STATE_WORDS]; /**< the fault states */
+  uint32_t generation;             /**< generation of the snapshot */
+} app_state_snapshot_t;
+
+/**
+ * @brief the state store of a device
+ * each device (instance) has its own store
+ *
+ * @param device the device index
+ * @return the store, NULL if device >= APP_MAX_DEVICES
+ */
+app_state_t *app_state_store(size_t device);
+
+/**
+ * @brief clears all values, faults and dirty bits
+ *
+ * @param state the store
+ */
+void app_state_init(app_state_t *state);
+
+/**
+ * @brief retrieve the value of a data point
+ *
+ * @param state the store
+ * @param id the data point id
+ * @return the value
+ */
+bool app_state_get(app_state_t *state, int id);
+
+/**
+ * @brief set the value of a data point
+ * when the value changes the dirty bit is set and the generation incremented
+ *
+ * @param state the store
+ * @param id the data point id
+ * @param value the new value
+ * @return the previous value
+ */
+bool app_state_set(app_state_t *state, int id, bool value);
+
+/**
+ * @brief set the value of a data point to true
+ *
+ * @param state the store
+ * @param id the data point id
+ * @return the previous value
+ */
+bool app_state_test_and_set(app_state_t *state, int id);
+
+/**
+ * @brief toggle the value of a data point
+ *
+ * @param state the store
+ * @param id the data point id
+ * @return the new value
+ */
+bool app_state_toggle(app_state_t *state, int id);
+
+/**
+ * @brief retrieve the fault state of a data point
+ *
+ * @param state the store
+ * @param id the data point id
+ * @return the fault state
+ */
+bool app_state_get_fault(app_state_t *state, int id);
+
+/**
+ * @brief set the fault state of a data point
+ *
+ * @param state the store
+ * @param id the data point id
+ * @param fault the new fault state
+ * @return the previous fault state
+ */
+bool app_state_set_fault(app_state_t *state, int id, bool fault);
+
+/**
+ * @brief the generation of the store, changes on every change of the store
+ *
+ * @param state the store
+ * @return the generation
+ */
+uint32_t app_state_generation(app_state_t *state);
+
+/**
+ * @brief take a snapshot of the values and faults
+ *
+ * @param state the store
+ * @param snapshot the snapshot to fill in
+ */
+void app_state_snapshot(app_state_t *state, app_state_snapshot_t *snapshot);
+
+/**
+ * @brief compute which data points differ between two snapshots
+ *
+ * @param older the older snapshot
+ * @param newer the newer snapshot
+ * @param changed bitset (APP_STATE_WORDS) of the data points with a changed
+ * value or fault state
+ * @return true if at least one data point changed
+ */
+bool app_state_diff(const app_state_snapshot_t *older,
+                    const app_state_snapshot_t *newer, uint32_t *changed);
+
+/**
+ * @brief take (and clear) the dirty bits
+ *
+ * @param state the store
+ * @param dirty bitset (APP_STATE_WORDS) of the data points changed since the
+ * previous call
+ * @return true if at least one data point was dirty
+ */
+bool app_state_take_dirty(app_state_t *state, uint32_t *dirty);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_STATE_H */
@@ -0,0 +1,340 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * per data point counters and handler latency histograms
+ *
+ * Bucket b < 4 holds the value b, above that each power of 2 is split in 4
+ * buckets: value v with highest bit e is in bucket (e - 1) * 4 + the 2 bits
+ * below the highest bit. The lower bound of a bucket is used as its value.
+ * A reader on another thread (or on 32 bit, a signal handler) can see a
+ * 64 bit counter that is being updated: the stats are a diagnostic.
+ */
+#include "knx_iot_virtual_stats.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_trace.h"
+
+#include "oc_api.h"
+#include "oc_rep.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define APP_STATS_WRITE(fd, buf, len) _write((fd), (buf), (unsigned int)(len))
+#else
+#include <unistd.h>
+#define APP_STATS_WRITE(fd, buf, len) write((fd), (buf), (len))
+#endif
+
+#define APP_STATS_SUB (1 << APP_STATS_SUB_BITS) /**< buckets per power of 2 */
+#define APP_STATS_MAX_GET_DP 16      /**< max data points in one GET */
+#define APP_STATS_MAX_GET_BUCKETS 48 /**< max buckets per histogram in a GET */
+#define APP_STATS_DP_SIZE 48         /**< max encoded size of a data point */
+#define APP_STATS_BUCKET_SIZE 16     /**< max encoded size of a bucket */
+
+static app_stats_dp_t g_stats_dp[APP_DP_MAX]; /**< the data point counters */
+static app_stats_hist_t g_stats_hist[APP_STATS_METHODS]; /**< per method */
+
+/**
+ * @brief the names of the methods (dump)
+ */
+static const char *g_stats_method_name[APP_STATS_METHODS] = { "GET", "PUT" };
+
+/**
+ * @brief the bucket of a value
+ */
+static int
+app_stats_bucket(uint64_t value)
+{
+  int e = 0;
+  int bucket;
+
+  if (value < APP_STATS_SUB) {
+    return (int)value;
+  }
+  while ((value >> e) > 1) {
+    e++;
+  }
+  bucket = (e - APP_STATS_SUB_BITS + 1) * APP_STATS_SUB +
+           (int)((value >> (e - APP_STATS_SUB_BITS)) & (APP_STATS_SUB - 1));
+  return (bucket < APP_STATS_BUCKETS) ? bucket : APP_STATS_BUCKETS - 1;
+}
+
+/**
+ * @brief the lower bound of a bucket
+ */
+static uint64_t
+app_stats_bucket_value(int bucket)
+{
+  if (bucket < APP_STATS_SUB) {
+    return (uint64_t)bucket;
+  }
+  return (uint64_t)(APP_STATS_SUB + bucket % APP_STATS_SUB)
+         << (bucket / APP_STATS_SUB - 1);
+}
+
+void
+app_stats_hist_add(app_stats_hist_t *hist, uint64_t ns)
+{
+  hist->buckets[app_stats_bucket(ns)]++;
+  hist->count++;
+}
+
+uint64_t
+app_stats_hist_percentile(const app_stats_hist_t *hist, int per_mille)
+{
+  uint64_t target;
+  uint64_t seen = 0;
+  int bucket;
+
+  if (hist->count == 0) {
+    return 0;
+  }
+  // the rank of the percentile, rounded up
+  target = ((uint64_t)hist->count * (uint64_t)per_mille + 999) / 1000;
+  if (target == 0) {
+    target = 1;
+  }
+  for (bucket = 0; bucket < APP_STATS_BUCKETS; bucket++) {
+    seen += hist->buckets[bucket];
+    if (seen >= target) {
+      return app_stats_bucket_value(bucket);
+    }
+  }
+  return app_stats_bucket_value(APP_STATS_BUCKETS - 1);
+}
+
+void
+app_stats_request(int method, int id, int status, bool redirected,
+                  uint64_t ns)
+{
+  app_stats_dp_t *dp;
+
+  if (method < 0 || method >= APP_STATS_METHODS) {
+    return;
+  }
+  app_stats_hist_add(&g_stats_hist[method], ns);
+  if (id < 0 || id >= APP_DP_MAX) {
+    return;
+  }
+  dp = &g_stats_dp[id];
+  if (method == APP_STATS_GET) {
+    dp->get++;
+  } else {
+    dp->put++;
+  }
+  // 4.xx and 5.xx responses: the codes after OC_STATUS_NOT_MODIFIED
+  if (status > OC_STATUS_NOT_MODIFIED) {
+    dp->errors++;
+  }
+  if (redirected) {
+    dp->redirected++;
+  }
+  if (ns > dp->max_ns) {
+    dp->max_ns = ns;
+  }
+  dp->total_ns += ns;
+}
+
+void
+app_stats_s_mode(int id)
+{
+  if (id >= 0 && id < APP_DP_MAX) {
+    g_stats_dp[id].s_mode++;
+  }
+}
+
+const app_stats_dp_t *
+app_stats_dp(int id)
+{
+  if (id < 0 || id >= APP_DP_MAX) {
+    return NULL;
+  }
+  return &g_stats_dp[id];
+}
+
+uint64_t
+app_stats_percentile(int method, int per_mille)
+{
+  if (method < 0 || method >= APP_STATS_METHODS) {
+    return 0;
+  }
+  return app_stats_hist_percentile(&g_stats_hist[method], per_mille);
+}
+
+/**
+ * @brief the data point is used (has a counter that is not zero)
+ */
+static bool
+app_stats_dp_active(const app_stats_dp_t *dp)
+{
+  return dp->get != 0 || dp->put != 0 || dp->s_mode != 0;
+}
+
+void
+app_stats_dump_fd(int fd)
+{
+  static const int per_mille[] = { 500, 990, 999 };
+  static const char *per_mille_name[] = { " p50 ", " p99 ", " p999 " };
+  int count = app_dp_count();
+  char line[256];
+  char *pos;
+  int method;
+  int id;
+  int i;
+
+  for (method = 0; method < APP_STATS_METHODS; method++) {
+    pos = app_trace_format_text(line, "stats ");
+    pos = app_trace_format_text(pos, g_stats_method_name[method]);
+    pos = app_trace_format_text(pos, " count ");
+    pos = app_trace_format_number(pos, g_stats_hist[method].count);
+    for (i = 0; i < 3; i++) {
+      pos = app_trace_format_text(pos, per_mille_name[i]);
+      pos = app_trace_format_number(
+        pos, (int64_t)app_stats_percentile(method, per_mille[i]));
+    }
+    pos = app_trace_format_text(pos, " ns\n");
+    if (APP_STATS_WRITE(fd, line, (size_t)(pos - line)) < 0) {
+      return;
+    }
+  }
+
+  for (id = 0; id < count && id < APP_DP_MAX; id++) {
+    const app_stats_dp_t *dp = &g_stats_dp[id];
+    if (app_stats_dp_active(dp) == false) {
+      continue;
+    }
+    pos = app_trace_format_text(line, "stats ");
+    pos = app_trace_format_text(pos, app_dp_get(id)->url);
+    pos = app_trace_format_text(pos, " get ");
+    pos = app_trace_format_number(pos, dp->get);
+    pos = app_trace_format_text(pos, " put ");
+    pos = app_trace_format_number(pos, dp->put);
+    pos = app_trace_format_text(pos, " errors ");
+    pos = app_trace_format_number(pos, dp->errors);
+    pos = app_trace_format_text(pos, " redirected ");
+    pos = app_trace_format_number(pos, dp->redirected);
+    pos = app_trace_format_text(pos, " s-mode ");
+    pos = app_trace_format_number(pos, dp->s_mode);
+    pos = app_trace_format_text(pos, " max ");
+    pos = app_trace_format_number(pos, (int64_t)dp->max_ns);
+    pos = app_trace_format_text(pos, " total ");
+    pos = app_trace_format_number(pos, (int64_t)dp->total_ns);
+    pos = app_trace_format_text(pos, " ns\n");
+    if (APP_STATS_WRITE(fd, line, (size_t)(pos - line)) < 0) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief encode the histogram of a method: [ [lower bound, count] ...]
+ *
+ * @return the position after the histogram
+ */
+static uint8_t *
+app_stats_encode_hist(uint8_t *pos, int method)
+{
+  const uint32_t *hist = g_stats_hist[method].buckets;
+  int buckets = 0;
+  int bucket;
+
+  for (bucket = 0; bucket < APP_STATS_BUCKETS; bucket++) {
+    if (hist[bucket] != 0 && buckets < APP_STATS_MAX_GET_BUCKETS) {
+      buckets++;
+    }
+  }
+  pos = app_trace_cbor_head(pos, 0x80, (uint64_t)buckets);
+  for (bucket = 0; bucket < APP_STATS_BUCKETS && buckets > 0; bucket++) {
+    if (hist[bucket] == 0) {
+      continue;
+    }
+    pos = app_trace_cbor_head(pos, 0x80, 2);
+    pos = app_trace_cbor_head(pos, 0x00, app_stats_bucket_value(bucket));
+    pos = app_trace_cbor_head(pos, 0x00, hist[bucket]);
+    buckets--;
+  }
+  return pos;
+}
+
+/**
+ * @brief CoAP GET method of /x/stats
+ */
+static void
+app_stats_get_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                      void *user_data)
+{
+  uint8_t payload[16 + APP_STATS_MAX_GET_DP * APP_STATS_DP_SIZE +
+                  APP_STATS_METHODS * APP_STATS_MAX_GET_BUCKETS *
+                    APP_STATS_BUCKET_SIZE];
+  int ids[APP_STATS_MAX_GET_DP];
+  uint8_t *pos = payload;
+  int count = app_dp_count();
+  int active = 0;
+  int id;
+  int i;
+  (void)interfaces;
+  (void)user_data;
+
+  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
+    oc_send_response(request, OC_STATUS_BAD_OPTION);
+    return;
+  }
+  for (id = 0; id < count && id < APP_DP_MAX; id++) {
+    if (app_stats_dp_active(&g_stats_dp[id]) &&
+        active < APP_STATS_MAX_GET_DP) {
+      ids[active++] = id;
+    }
+  }
+
+  /* { 1: [ data points ], 2: GET histogram, 3: PUT histogram } */
+  pos = app_trace_cbor_head(pos, 0xA0, 3);
+  pos = app_trace_cbor_head(pos, 0x00, 1);
+  pos = app_trace_cbor_head(pos, 0x80, (uint64_t)active);
+  for (i = 0; i < active; i++) {
+    const app_stats_dp_t *dp = &g_stats_dp[ids[i]];
+    pos = app_trace_cbor_head(pos, 0x80, 8);
+    pos = app_trace_cbor_head(pos, 0x00, (uint64_t)ids[i]);
+    pos = app_trace_cbor_head(pos, 0x00, dp->get);
+    pos = app_trace_cbor_head(pos, 0x00, dp->put);
+    pos = app_trace_cbor_head(pos, 0x00, dp->errors);
+    pos = app_trace_cbor_head(pos, 0x00, dp->redirected);
+    pos = app_trace_cbor_head(pos, 0x00, dp->s_mode);
+    pos = app_trace_cbor_head(pos, 0x00, dp->max_ns);
+    pos = app_trace_cbor_head(pos, 0x00, dp->total_ns);
+  }
+  pos = app_trace_cbor_head(pos, 0x00, 2);
+  pos = app_stats_encode_hist(pos, APP_STATS_GET);
+  pos = app_trace_cbor_head(pos, 0x00, 3);
+  pos = app_stats_encode_hist(pos, APP_STATS_PUT);
+  oc_rep_encode_raw(payload, (size_t)(pos - payload));
+  oc_send_cbor_response(request, OC_STATUS_OK);
+}
+
+void
+app_stats_register_resource(size_t device)
+{
+  oc_resource_t *res = oc_new_resource("stats", APP_STATS_URL, 1, device);
+  oc_resource_bind_resource_type(res, "urn:knx:x.stats");
+  oc_resource_bind_content_type(res, APPLICATION_CBOR);
+  oc_resource_bind_resource_interface(res, OC_IF_D);
+  oc_resource_set_discoverable(res, true);
+  oc_resource_set_request_handler(res, OC_GET, app_stats_get_handler, NULL);
+  oc_add_resource(res);
+}
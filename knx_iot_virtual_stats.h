@@ -0,0 +1,160 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * per data point counters and handler latency histograms, shared by the
+ * virtual applications.
+ *
+ * The data point handlers count the GET and PUT requests, the errors, the
+ * redirected (s-mode) requests and the s-mode messages sent, per data point.
+ * The handler latency is recorded in a log bucket histogram per method
+ * (4 buckets per power of 2, about 25% precision), from which the
+ * percentiles are derived.
+ * The counters are only written by the stack thread, without locks; the
+ * readers (the diagnostic resource /x/stats, the text dump on a signal)
+ * read them as they are.
+ */
+#ifndef KNX_IOT_VIRTUAL_STATS_H
+#define KNX_IOT_VIRTUAL_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_STATS_URL "/x/stats" /**< the diagnostic resource */
+#define APP_STATS_SUB_BITS 2     /**< log2 of the buckets per power of 2 */
+#define APP_STATS_BUCKETS 160    /**< buckets of a histogram (up to ~2^40 ns) */
+
+/**
+ * @brief the methods with a latency histogram
+ */
+typedef enum {
+  APP_STATS_GET = 0, /**< the GET handler */
+  APP_STATS_PUT = 1, /**< the PUT handler */
+  APP_STATS_METHODS
+} app_stats_method_t;
+
+/**
+ * @brief the counters of a data point
+ */
+typedef struct app_stats_dp_t
+{
+  uint32_t get;        /**< GET requests */
+  uint32_t put;        /**< PUT requests */
+  uint32_t errors;     /**< requests with an error response */
+  uint32_t redirected; /**< redirected requests (s-mode received) */
+  uint32_t s_mode;     /**< s-mode messages sent */
+  uint64_t max_ns;     /**< the slowest request */
+  uint64_t total_ns;   /**< the time spent in the handlers */
+} app_stats_dp_t;
+
+/**
+ * @brief a latency histogram
+ */
+typedef struct app_stats_hist_t
+{
+  uint32_t count;                       /**< the number of samples */
+  uint32_t buckets[APP_STATS_BUCKETS]; /**< the samples per bucket */
+} app_stats_hist_t;
+
+/**
+ * @brief add a sample to a histogram
+ *
+ * @param hist the histogram
+ * @param ns the sample in nanoseconds
+ */
+void app_stats_hist_add(app_stats_hist_t *hist, uint64_t ns);
+
+/**
+ * @brief a percentile of a histogram
+ * the lower bound of the bucket that holds the percentile
+ *
+ * @param hist the histogram
+ * @param per_mille the percentile in 1/1000 (e.g. 990 == p99)
+ * @return the value in nanoseconds, 0 if the histogram is empty
+ */
+uint64_t app_stats_hist_percentile(const app_stats_hist_t *hist,
+                                   int per_mille);
+
+/**
+ * @brief account a request handled by a data point handler
+ *
+ * @param method the method (app_stats_method_t)
+ * @param id the data point id
+ * @param status the response code (oc_status_t)
+ * @param redirected the request is redirected (s-mode)
+ * @param ns the duration of the handler in nanoseconds
+ */
+void app_stats_request(int method, int id, int status, bool redirected,
+                       uint64_t ns);
+
+/**
+ * @brief account an s-mode message sent for a data point
+ *
+ * @param id the data point id
+ */
+void app_stats_s_mode(int id);
+
+/**
+ * @brief the counters of a data point
+ *
+ * @param id the data point id
+ * @return the counters, NULL if the id is out of range
+ */
+const app_stats_dp_t *app_stats_dp(int id);
+
+/**
+ * @brief a percentile of the latency of a method
+ *
+ * @param method the method (app_stats_method_t)
+ * @param per_mille the percentile in 1/1000 (e.g. 990 == p99)
+ * @return the latency in nanoseconds, 0 if nothing is recorded
+ */
+uint64_t app_stats_percentile(int method, int per_mille);
+
+/**
+ * @brief write the counters and percentiles as text
+ * async signal safe: formats without stdio, writes with write()
+ *
+ * @param fd the file descriptor (e.g. 1 == stdout)
+ */
+void app_stats_dump_fd(int fd);
+
+/**
+ * @brief register the diagnostic resource /x/stats
+ * GET returns
+ * { 1: [ [id, get, put, errors, redirected, s-mode, max ns, total ns] ...],
+ *   2: GET histogram [ [lower bound ns, count] ...],
+ *   3: PUT histogram [ [lower bound ns, count] ...] }
+ * with only the data points and buckets that are not zero
+ *
+ * @param device the device index
+ */
+void app_stats_register_resource(size_t device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_STATS_H */
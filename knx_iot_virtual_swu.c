@@ -0,0 +1,739 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * software update sink
+ *
+ * Linux: the file is written with pwrite, preallocated with posix_fallocate
+ * and synced with fdatasync before the rename, on a thread that is joined
+ * before the next download of the device and by app_swu_shutdown.
+ * Other platforms: stdio (fseek + fwrite) on the stack thread.
+ * The coverage bitmap has a bit per 16 bytes (the smallest CoAP block), it
+ * is allocated with the session: 8 KB for an image of 1 MB.
+ * A session is restarted when a block at offset 0 differs from the stored
+ * first bytes (another image of the same size), or when no block arrived for
+ * APP_SWU_IDLE_TIMEOUT seconds.
+ * The hash covers the bytes stored in order from offset 0: a block at the
+ * end of the hashed part is hashed from the payload, a block that fills a
+ * gap is followed by hashing the stored blocks behind it, read back from the
+ * file (page cache), so the hash never waits for the last block.
+ * SHA-256 is implemented here (FIPS 180-4), the stack does not always link
+ * a crypto library (unsecured builds).
+ */
+#ifdef __linux__
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "oc_api.h"
+
+#include "knx_iot_virtual_swu.h"
+#include "knx_iot_virtual_dp.h"
+#include "knx_iot_virtual_trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APP_SWU_READ_BUFFER 4096 /**< read buffer of the hash catch up */
+#define APP_SWU_UNIT 16          /**< bytes per bit of the coverage bitmap */
+#define APP_SWU_HEAD 64          /**< bytes kept of the block at offset 0 */
+
+/**
+ * @brief the SHA-256 state
+ */
+typedef struct app_sha256_t
+{
+  uint32_t state[8];  /**< the hash state */
+  uint64_t length;    /**< bytes hashed */
+  uint8_t block[64];  /**< the partial block */
+  size_t used;        /**< bytes in the partial block */
+} app_sha256_t;
+
+/**
+ * @brief a download
+ */
+typedef struct app_swu_session_t
+{
+#ifdef __linux__
+  int fd;                      /**< the partial file */
+#else
+  FILE *file;                  /**< the partial file */
+#endif
+  size_t size;                 /**< the size of the image */
+  size_t units;                /**< the number of bits in the coverage */
+  size_t covered;              /**< the number of bits set */
+  uint8_t *coverage;           /**< a bit per stored unit (APP_SWU_UNIT) */
+  size_t hashed;               /**< bytes hashed, from offset 0 */
+  app_sha256_t sha;            /**< the hash of the image */
+  uint8_t head[APP_SWU_HEAD];  /**< the first bytes of the image */
+  size_t head_len;             /**< the bytes in head */
+  oc_clock_time_t last;        /**< time of the last block */
+  char path[FILENAME_MAX];     /**< the file name of the image */
+  char part[FILENAME_MAX + 5]; /**< the file name of the partial file */
+} app_swu_session_t;
+
+static app_swu_session_t *g_swu[APP_MAX_DEVICES]; /**< download per device */
+
+#ifdef __linux__
+static pthread_t g_swu_thread[APP_MAX_DEVICES]; /**< finishing an image */
+static bool g_swu_finishing[APP_MAX_DEVICES];   /**< the thread is started */
+#endif
+
+static const uint32_t g_sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define APP_SHA256_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * @brief hash one 64 byte block
+ */
+static void
+app_sha256_transform(app_sha256_t *sha, const uint8_t *data)
+{
+  uint32_t w[64];
+  uint32_t a, b, c, d, e, f, g, h;
+  uint32_t t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)data[i * 4] << 24) | ((uint32_t)data[i * 4 + 1] << 16) |
+           ((uint32_t)data[i * 4 + 2] << 8) | (uint32_t)data[i * 4 + 3];
+  }
+  for (i = 16; i < 64; i++) {
+    uint32_t s0 = APP_SHA256_ROR(w[i - 15], 7) ^
+                  APP_SHA256_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = APP_SHA256_ROR(w[i - 2], 17) ^
+                  APP_SHA256_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  a = sha->state[0];
+  b = sha->state[1];
+  c = sha->state[2];
+  d = sha->state[3];
+  e = sha->state[4];
+  f = sha->state[5];
+  g = sha->state[6];
+  h = sha->state[7];
+  for (i = 0; i < 64; i++) {
+    t1 = h +
+         (APP_SHA256_ROR(e, 6) ^ APP_SHA256_ROR(e, 11) ^
+          APP_SHA256_ROR(e, 25)) +
+         ((e & f) ^ (~e & g)) + g_sha256_k[i] + w[i];
+    t2 = (APP_SHA256_ROR(a, 2) ^ APP_SHA256_ROR(a, 13) ^
+          APP_SHA256_ROR(a, 22)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  sha->state[0] += a;
+  sha->state[1] += b;
+  sha->state[2] += c;
+  sha->state[3] += d;
+  sha->state[4] += e;
+  sha->state[5] += f;
+  sha->state[6] += g;
+  sha->state[7] += h;
+}
+
+static void
+app_sha256_init(app_sha256_t *sha)
+{
+  static const uint32_t init[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                    0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                    0x1f83d9ab, 0x5be0cd19 };
+  memcpy(sha->state, init, sizeof(init));
+  sha->length = 0;
+  sha->used = 0;
+}
+
+static void
+app_sha256_update(app_sha256_t *sha, const uint8_t *data, size_t len)
+{
+  sha->length += len;
+  if (sha->used > 0) {
+    size_t n = 64 - sha->used;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(sha->block + sha->used, data, n);
+    sha->used += n;
+    data += n;
+    len -= n;
+    if (sha->used < 64) {
+      return;
+    }
+    app_sha256_transform(sha, sha->block);
+    sha->used = 0;
+  }
+  while (len >= 64) {
+    app_sha256_transform(sha, data);
+    data += 64;
+    len -= 64;
+  }
+  memcpy(sha->block, data, len);
+  sha->used = len;
+}
+
+static void
+app_sha256_final(app_sha256_t *sha, uint8_t *digest)
+{
+  uint64_t bits = sha->length * 8;
+  int i;
+
+  sha->block[sha->used++] = 0x80;
+  if (sha->used > 56) {
+    memset(sha->block + sha->used, 0, 64 - sha->used);
+    app_sha256_transform(sha, sha->block);
+    sha->used = 0;
+  }
+  memset(sha->block + sha->used, 0, 56 - sha->used);
+  for (i = 0; i < 8; i++) {
+    sha->block[63 - i] = (uint8_t)(bits >> (i * 8));
+  }
+  app_sha256_transform(sha, sha->block);
+  for (i = 0; i < 32; i++) {
+    digest[i] = (uint8_t)(sha->state[i / 4] >> (24 - (i % 4) * 8));
+  }
+}
+
+void
+app_swu_sha256(const uint8_t *data, size_t len, uint8_t *digest)
+{
+  app_sha256_t sha;
+  app_sha256_init(&sha);
+  app_sha256_update(&sha, data, len);
+  app_sha256_final(&sha, digest);
+}
+
+/**
+ * @brief create the partial file, preallocated with the size of the image
+ */
+static int
+app_swu_file_open(app_swu_session_t *s)
+{
+#ifdef __linux__
+  int err;
+  s->fd = open(s->part, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (s->fd < 0) {
+    return -1;
+  }
+  /* reserve the blocks, the file system may not support it */
+  err = posix_fallocate(s->fd, 0, (off_t)s->size);
+  if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+    close(s->fd);
+    s->fd = -1;
+    return -1;
+  }
+  return 0;
+#else
+  s->file = fopen(s->part, "w+b");
+  return (s->file != NULL) ? 0 : -1;
+#endif /* __linux__ */
+}
+
+/**
+ * @brief write data at an offset of the partial file
+ */
+static int
+app_swu_file_write(app_swu_session_t *s, size_t offset, const uint8_t *data,
+                   size_t len)
+{
+#ifdef __linux__
+  while (len > 0) {
+    ssize_t n = pwrite(s->fd, data, len, (off_t)offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += n;
+    offset += (size_t)n;
+    len -= (size_t)n;
+  }
+  return 0;
+#else
+  if (fseek(s->file, (long)offset, SEEK_SET) != 0 ||
+      fwrite(data, 1, len, s->file) != len) {
+    return -1;
+  }
+  return 0;
+#endif /* __linux__ */
+}
+
+/**
+ * @brief read data at an offset of the partial file
+ */
+static int
+app_swu_file_read(app_swu_session_t *s, size_t offset, uint8_t *data,
+                  size_t len)
+{
+#ifdef __linux__
+  while (len > 0) {
+    ssize_t n = pread(s->fd, data, len, (off_t)offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    data += n;
+    offset += (size_t)n;
+    len -= (size_t)n;
+  }
+  return 0;
+#else
+  if (fflush(s->file) != 0 || fseek(s->file, (long)offset, SEEK_SET) != 0 ||
+      fread(data, 1, len, s->file) != len) {
+    return -1;
+  }
+  return 0;
+#endif /* __linux__ */
+}
+
+/**
+ * @brief close the partial file
+ * @param sync write the data to the disk first
+ */
+static int
+app_swu_file_close(app_swu_session_t *s, bool sync)
+{
+  int err = 0;
+#ifdef __linux__
+  if (s->fd >= 0) {
+    if (sync && fdatasync(s->fd) != 0) {
+      err = -1;
+    }
+    if (close(s->fd) != 0) {
+      err = -1;
+    }
+    s->fd = -1;
+  }
+#else
+  (void)sync;
+  if (s->file != NULL) {
+    if (fclose(s->file) != 0) {
+      err = -1;
+    }
+    s->file = NULL;
+  }
+#endif /* __linux__ */
+  return err;
+}
+
+/**
+ * @brief hash the part of the image that is not hashed yet
+ */
+static int
+app_swu_hash_to(app_swu_session_t *s, size_t end)
+{
+  uint8_t buffer[APP_SWU_READ_BUFFER];
+
+  while (s->hashed < end) {
+    size_t n = end - s->hashed;
+    if (n > sizeof(buffer)) {
+      n = sizeof(buffer);
+    }
+    if (app_swu_file_read(s, s->hashed, buffer, n) != 0) {
+      return -1;
+    }
+    app_sha256_update(&s->sha, buffer, n);
+    s->hashed += n;
+  }
+  return 0;
+}
+
+/**
+ * @brief finish an image: hash, sync, close and rename
+ * frees the session
+ */
+static void
+app_swu_finish(app_swu_session_t *s)
+{
+  uint8_t digest[APP_SWU_DIGEST_SIZE];
+  char hex[APP_SWU_DIGEST_SIZE * 2 + 1];
+  int i;
+
+  if (app_swu_hash_to(s, s->size) != 0 || app_swu_file_close(s, true) != 0) {
+    PRINT("swu: can't finish %s\n", s->part);
+    app_swu_file_close(s, false);
+    remove(s->part);
+    free(s);
+    return;
+  }
+#ifdef WIN32
+  /* rename does not replace an existing file on windows */
+  remove(s->path);
+#endif
+  if (rename(s->part, s->path) != 0) {
+    PRINT("swu: can't rename %s\n", s->part);
+    remove(s->part);
+    free(s);
+    return;
+  }
+  app_sha256_final(&s->sha, digest);
+  for (i = 0; i < APP_SWU_DIGEST_SIZE; i++) {
+    sprintf(&hex[i * 2], "%02x", digest[i]);
+  }
+  PRINT("swu: %s complete, %u bytes, sha256 %s\n", s->path, (unsigned)s->size,
+        hex);
+  free(s);
+}
+
+#ifdef __linux__
+/**
+ * @brief the finishing thread
+ */
+static void *
+app_swu_finish_thread(void *data)
+{
+  app_swu_finish((app_swu_session_t *)data);
+  return NULL;
+}
+#endif /* __linux__ */
+
+void
+app_swu_abort(size_t device)
+{
+  app_swu_session_t *s;
+
+  if (device >= APP_MAX_DEVICES || g_swu[device] == NULL) {
+    return;
+  }
+  s = g_swu[device];
+  g_swu[device] = NULL;
+  app_swu_file_close(s, false);
+  remove(s->part);
+  free(s);
+}
+
+/**
+ * @brief start a download
+ */
+/**
+ * @brief wait for the finishing thread of a device
+ */
+static void
+app_swu_join(size_t device)
+{
+#ifdef __linux__
+  if (g_swu_finishing[device]) {
+    pthread_join(g_swu_thread[device], NULL);
+    g_swu_finishing[device] = false;
+  }
+#else
+  (void)device;
+#endif /* __linux__ */
+}
+
+void
+app_swu_shutdown(void)
+{
+  size_t device;
+
+  for (device = 0; device < APP_MAX_DEVICES; device++) {
+    app_swu_abort(device);
+    app_swu_join(device);
+  }
+}
+
+static app_swu_session_t *
+app_swu_start(size_t device, const char *path, size_t binary_size)
+{
+  app_swu_session_t *s;
+  size_t units;
+
+  app_swu_abort(device);
+  /* the previous image may use the same partial file */
+  app_swu_join(device);
+  units = (binary_size + APP_SWU_UNIT - 1) / APP_SWU_UNIT;
+  /* the coverage bitmap follows the session */
+  s = (app_swu_session_t *)calloc(1, sizeof(app_swu_session_t) +
+                                       (units + 7) / 8);
+  if (s == NULL) {
+    return NULL;
+  }
+  s->size = binary_size;
+  s->units = units;
+  s->coverage = (uint8_t *)(s + 1);
+  strncpy(s->path, path, sizeof(s->path) - 1);
+  snprintf(s->part, sizeof(s->part), "%s.part", path);
+  app_sha256_init(&s->sha);
+  if (app_swu_file_open(s) != 0) {
+    PRINT("swu: can't create %s\n", s->part);
+    free(s);
+    return NULL;
+  }
+  g_swu[device] = s;
+  return s;
+}
+
+/**
+ * @brief mark the units of a block as stored
+ * a unit is stored when the block covers it completely, or when the block
+ * ends the image (the last unit can be partial)
+ */
+static void
+app_swu_cover(app_swu_session_t *s, size_t offset, size_t len)
+{
+  size_t unit = (offset + APP_SWU_UNIT - 1) / APP_SWU_UNIT;
+  size_t end = (offset + len == s->size) ? s->units
+                                         : (offset + len) / APP_SWU_UNIT;
+
+  for (; unit < end; unit++) {
+    uint8_t mask = (uint8_t)(1u << (unit % 8));
+    if ((s->coverage[unit / 8] & mask) == 0) {
+      s->coverage[unit / 8] |= mask;
+      s->covered++;
+    }
+  }
+}
+
+/**
+ * @brief checks if a unit is stored
+ */
+static bool
+app_swu_unit_stored(const app_swu_session_t *s, size_t unit)
+{
+  return (s->coverage[unit / 8] & (1u << (unit % 8))) != 0;
+}
+
+/**
+ * @brief the end of the stored bytes from offset 0
+ */
+static size_t
+app_swu_stored_prefix(const app_swu_session_t *s)
+{
+  size_t unit = s->hashed / APP_SWU_UNIT;
+
+  while (unit < s->units && app_swu_unit_stored(s, unit)) {
+    unit++;
+  }
+  return (unit * APP_SWU_UNIT < s->size) ? unit * APP_SWU_UNIT : s->size;
+}
+
+/**
+ * @brief aborts the download of a device when it is idle for too long
+ */
+static void
+app_swu_expire(size_t device)
+{
+  const app_swu_session_t *s = g_swu[device];
+
+  if (s != NULL &&
+      oc_clock_time() - s->last > APP_SWU_IDLE_TIMEOUT * OC_CLOCK_SECOND) {
+    PRINT("swu: %s idle, download aborted\n", s->part);
+    app_swu_abort(device);
+  }
+}
+
+/**
+ * @brief checks if a block belongs to the image of the session
+ * a block at offset 0 must match the first bytes that are stored
+ */
+static bool
+app_swu_same_image(const app_swu_session_t *s, const char *path,
+                   size_t binary_size, size_t offset, const uint8_t *payload,
+                   size_t len)
+{
+  size_t n = (len < s->head_len) ? len : s->head_len;
+
+  if (s->size != binary_size || strcmp(s->path, path) != 0) {
+    return false;
+  }
+  return offset != 0 || memcmp(s->head, payload, n) == 0;
+}
+
+app_swu_result_t
+app_swu_block(size_t device, const char *path, size_t binary_size,
+              size_t offset, const uint8_t *payload, size_t len)
+{
+  app_swu_session_t *s;
+  size_t prefix;
+
+  if (device >= APP_MAX_DEVICES || path == NULL || binary_size == 0 ||
+      offset + len > binary_size) {
+    PRINT("swu: invalid block %u+%u of %u\n", (unsigned)offset, (unsigned)len,
+          (unsigned)binary_size);
+    return APP_SWU_ERROR;
+  }
+  app_swu_expire(device);
+  s = g_swu[device];
+  if (s == NULL ||
+      app_swu_same_image(s, path, binary_size, offset, payload, len) == false) {
+    s = app_swu_start(device, path, binary_size);
+    if (s == NULL) {
+      return APP_SWU_ERROR;
+    }
+  }
+  s->last = oc_clock_time();
+  if (app_swu_file_write(s, offset, payload, len) != 0) {
+    PRINT("swu: can't write %s\n", s->part);
+    app_swu_abort(device);
+    return APP_SWU_ERROR;
+  }
+  if (offset == 0 && s->head_len == 0) {
+    s->head_len = (len < APP_SWU_HEAD) ? len : APP_SWU_HEAD;
+    memcpy(s->head, payload, s->head_len);
+  }
+  app_swu_cover(s, offset, len);
+  if (offset <= s->hashed && offset + len > s->hashed) {
+    /* the block extends the hashed part */
+    size_t skip = s->hashed - offset;
+    app_sha256_update(&s->sha, payload + skip, len - skip);
+    s->hashed = offset + len;
+  }
+  prefix = app_swu_stored_prefix(s);
+  if (prefix > s->hashed && app_swu_hash_to(s, prefix) != 0) {
+    PRINT("swu: can't read %s\n", s->part);
+    app_swu_abort(device);
+    return APP_SWU_ERROR;
+  }
+  if (s->covered < s->units) {
+    return APP_SWU_STORED;
+  }
+
+  /* the last block: finish the image off the stack thread */
+  g_swu[device] = NULL;
+#ifdef __linux__
+  if (pthread_create(&g_swu_thread[device], NULL, app_swu_finish_thread, s) ==
+      0) {
+    g_swu_finishing[device] = true;
+    return APP_SWU_COMPLETE;
+  }
+#endif /* __linux__ */
+  app_swu_finish(s);
+  return APP_SWU_COMPLETE;
+}
+
+int
+app_swu_missing(size_t device, size_t *size, size_t *stored,
+                app_swu_range_t *ranges, int max)
+{
+  const app_swu_session_t *s;
+  size_t unit;
+  int count = 0;
+
+  *size = 0;
+  *stored = 0;
+  if (device >= APP_MAX_DEVICES) {
+    return 0;
+  }
+  app_swu_expire(device);
+  if (g_swu[device] == NULL) {
+    return 0;
+  }
+  s = g_swu[device];
+  *size = s->size;
+  *stored = s->covered * APP_SWU_UNIT;
+  if (app_swu_unit_stored(s, s->units - 1)) {
+    /* the last unit is partial */
+    *stored -= s->units * APP_SWU_UNIT - s->size;
+  }
+  for (unit = 0; unit < s->units && count < max;) {
+    size_t start;
+    if (app_swu_unit_stored(s, unit)) {
+      unit++;
+      continue;
+    }
+    start = unit;
+    while (unit < s->units && app_swu_unit_stored(s, unit) == false) {
+      unit++;
+    }
+    ranges[count].offset = start * APP_SWU_UNIT;
+    ranges[count].length =
+      ((unit * APP_SWU_UNIT < s->size) ? unit * APP_SWU_UNIT : s->size) -
+      ranges[count].offset;
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief CoAP GET method of /x/swu
+ */
+static void
+app_swu_get_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                    void *user_data)
+{
+  app_swu_range_t ranges[APP_SWU_MAX_GET_RANGES];
+  uint8_t payload[32 + APP_SWU_MAX_GET_RANGES * 20];
+  uint8_t *pos = payload;
+  size_t size;
+  size_t stored;
+  int count;
+  int i;
+  (void)interfaces;
+  (void)user_data;
+
+  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
+    oc_send_response(request, OC_STATUS_BAD_OPTION);
+    return;
+  }
+  count = app_swu_missing(request->resource->device, &size, &stored, ranges,
+                          APP_SWU_MAX_GET_RANGES);
+
+  /* { 1: image size, 2: bytes stored, 3: [ [offset, length] ...] } */
+  pos = app_trace_cbor_head(pos, 0xA0, 3);
+  pos = app_trace_cbor_head(pos, 0x00, 1);
+  pos = app_trace_cbor_head(pos, 0x00, size);
+  pos = app_trace_cbor_head(pos, 0x00, 2);
+  pos = app_trace_cbor_head(pos, 0x00, stored);
+  pos = app_trace_cbor_head(pos, 0x00, 3);
+  pos = app_trace_cbor_head(pos, 0x80, (uint64_t)count);
+  for (i = 0; i < count; i++) {
+    pos = app_trace_cbor_head(pos, 0x80, 2);
+    pos = app_trace_cbor_head(pos, 0x00, ranges[i].offset);
+    pos = app_trace_cbor_head(pos, 0x00, ranges[i].length);
+  }
+  oc_rep_encode_raw(payload, (size_t)(pos - payload));
+  oc_send_cbor_response(request, OC_STATUS_OK);
+}
+
+void
+app_swu_register_resource(size_t device)
+{
+  oc_resource_t *res = oc_new_resource("swu", APP_SWU_URL, 1, device);
+  oc_resource_bind_resource_type(res, "urn:knx:x.swu");
+  oc_resource_bind_content_type(res, APPLICATION_CBOR);
+  oc_resource_bind_resource_interface(res, OC_IF_D);
+  oc_resource_set_discoverable(res, true);
+  oc_resource_set_request_handler(res, OC_GET, app_swu_get_handler, NULL);
+  oc_add_resource(res);
+}
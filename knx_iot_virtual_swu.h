@@ -0,0 +1,142 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * software update sink, shared by the virtual applications.
+ *
+ * A download (per device) keeps one file open for the whole transfer:
+ * <path>.part, preallocated with the size of the image. The blocks can
+ * arrive in any order: each block is written at its offset, the stored
+ * ranges are tracked in a coverage bitmap and the image is hashed (SHA-256)
+ * while it is written, so the software update callback of the stack can
+ * acknowledge the block as soon as it is stored, and a client can send
+ * several blocks without waiting for each response.
+ * The missing ranges are reported by the diagnostic resource /x/swu, so a
+ * client can resend only what is missing.
+ * When all blocks are stored the file is synced, closed and renamed to
+ * <path>, on a separate thread (Linux), so the response of the last block
+ * does not wait for the disk. app_swu_shutdown waits for that thread.
+ * A download is identified by the path and the size of the image and its
+ * first bytes: a block of another image starts a new download. A download
+ * without blocks for APP_SWU_IDLE_TIMEOUT seconds is aborted (the partial
+ * file is removed), so a stale download is not continued by a new image.
+ * All functions are called from the stack thread.
+ */
+#ifndef KNX_IOT_VIRTUAL_SWU_H
+#define KNX_IOT_VIRTUAL_SWU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SWU_URL "/x/swu"      /**< the diagnostic resource */
+#define APP_SWU_DIGEST_SIZE 32    /**< size of the SHA-256 digest */
+#define APP_SWU_MAX_GET_RANGES 32 /**< max missing ranges in a GET */
+#define APP_SWU_IDLE_TIMEOUT 60   /**< seconds before an idle download ends */
+
+/**
+ * @brief a range of an image
+ */
+typedef struct app_swu_range_t
+{
+  size_t offset; /**< the offset in the image */
+  size_t length; /**< the length of the range */
+} app_swu_range_t;
+
+/**
+ * @brief the result of storing a block
+ */
+typedef enum {
+  APP_SWU_ERROR = -1,   /**< the block is not stored, the download is aborted */
+  APP_SWU_STORED = 0,   /**< the block is stored */
+  APP_SWU_COMPLETE = 1  /**< the block is stored and the image is complete */
+} app_swu_result_t;
+
+/**
+ * @brief store a block of a software image
+ *
+ * @param device the device index
+ * @param path the file name of the image
+ * @param binary_size the size of the image
+ * @param offset the offset of the block in the image
+ * @param payload the data of the block
+ * @param len the length of the block
+ * @return app_swu_result_t
+ */
+app_swu_result_t app_swu_block(size_t device, const char *path,
+                               size_t binary_size, size_t offset,
+                               const uint8_t *payload, size_t len);
+
+/**
+ * @brief the progress of the download of a device
+ *
+ * @param device the device index
+ * @param size the size of the image, 0 if there is no download
+ * @param stored the bytes stored
+ * @param ranges the missing ranges, in order
+ * @param max the size of ranges
+ * @return int the number of missing ranges (at most max)
+ */
+int app_swu_missing(size_t device, size_t *size, size_t *stored,
+                    app_swu_range_t *ranges, int max);
+
+/**
+ * @brief register the diagnostic resource /x/swu
+ * GET returns
+ * { 1: image size, 2: bytes stored, 3: [ [offset, length] ...] }
+ * with the first APP_SWU_MAX_GET_RANGES missing ranges of the download of
+ * the device, { 1: 0, 2: 0, 3: [] } when there is no download
+ *
+ * @param device the device index
+ */
+void app_swu_register_resource(size_t device);
+
+/**
+ * @brief abort the download of a device, removes the partial file
+ *
+ * @param device the device index
+ */
+void app_swu_abort(size_t device);
+
+/**
+ * @brief stop the software update sink
+ * aborts the unfinished downloads and waits until the completed images are
+ * written (finishing threads), to be called after oc_main_shutdown
+ */
+void app_swu_shutdown(void);
+
+/**
+ * @brief SHA-256 of a buffer (the hash used for the images)
+ *
+ * @param data the data
+ * @param len the length of the data
+ * @param digest the digest (APP_SWU_DIGEST_SIZE bytes)
+ */
+void app_swu_sha256(const uint8_t *data, size_t len, uint8_t *digest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_SWU_H */
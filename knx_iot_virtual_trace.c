@@ -0,0 +1,268 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+
+/**
+ * @file
+ *
+ * binary trace ring
+ *
+ * The write index is claimed with an atomic increment, so events can be
+ * recorded from any thread. A reader (dump, GET) can see an event that is
+ * being overwritten at that moment: the trace is a diagnostic, not a log.
+ * The payload of the GET is encoded by hand (fixed layout), and copied in
+ * the response buffer with oc_rep_encode_raw.
+ */
+#include "knx_iot_virtual_trace.h"
+#include "knx_iot_virtual_shard.h"
+
+#include "oc_api.h"
+#include "oc_rep.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#define APP_TRACE_WRITE(fd, buf, len) _write((fd), (buf), (unsigned int)(len))
+#define APP_TRACE_NEXT(p) ((uint32_t)InterlockedIncrement((volatile LONG *)(p)) - 1)
+#define APP_TRACE_LOAD(p) ((uint32_t)InterlockedOr((volatile LONG *)(p), 0))
+#else
+#include <unistd.h>
+#define APP_TRACE_WRITE(fd, buf, len) write((fd), (buf), (len))
+#define APP_TRACE_NEXT(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+#define APP_TRACE_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#endif
+
+#define APP_TRACE_MASK (APP_TRACE_SIZE - 1)
+#define APP_TRACE_EVENT_SIZE 16 /**< encoded size of an event */
+
+static app_trace_event_t g_trace_ring[APP_TRACE_SIZE]; /**< the events */
+static uint32_t g_trace_head = 0; /**< events recorded (next index) */
+
+/**
+ * @brief the names of the event types (dump)
+ */
+static const char *g_trace_type_name[] = { "?", "GET", "PUT", "S-MODE",
+                                           "NOTIFY" };
+
+void
+app_trace_add(uint8_t type, size_t device, int id, uint8_t status,
+              uint16_t value)
+{
+  app_trace_event_t *event =
+    &g_trace_ring[APP_TRACE_NEXT(&g_trace_head) & APP_TRACE_MASK];
+  event->time_ns = app_shard_time_ns();
+  event->device = (uint16_t)device;
+  event->id = (int16_t)id;
+  event->type = type;
+  event->status = status;
+  event->value = value;
+}
+
+int
+app_trace_copy(app_trace_event_t *events, int max)
+{
+  uint32_t head = APP_TRACE_LOAD(&g_trace_head);
+  uint32_t count = (head < APP_TRACE_SIZE) ? head : APP_TRACE_SIZE;
+  uint32_t i;
+
+  if (max < 0) {
+    return 0;
+  }
+  if (count > (uint32_t)max) {
+    count = (uint32_t)max;
+  }
+  for (i = 0; i < count; i++) {
+    events[i] = g_trace_ring[(head - count + i) & APP_TRACE_MASK];
+  }
+  return (int)count;
+}
+
+char *
+app_trace_format_number(char *pos, int64_t number)
+{
+  char digits[20];
+  int n = 0;
+  uint64_t value = (number < 0) ? (uint64_t)(-number) : (uint64_t)number;
+
+  if (number < 0) {
+    *pos++ = '-';
+  }
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) {
+    *pos++ = digits[--n];
+  }
+  return pos;
+}
+
+char *
+app_trace_format_text(char *pos, const char *text)
+{
+  while (*text != '\0') {
+    *pos++ = *text++;
+  }
+  return pos;
+}
+
+void
+app_trace_dump_fd(int fd)
+{
+  uint32_t head = APP_TRACE_LOAD(&g_trace_head);
+  uint32_t count = (head < APP_TRACE_SIZE) ? head : APP_TRACE_SIZE;
+  uint32_t i;
+  char line[128];
+  char *pos;
+
+  for (i = 0; i < count; i++) {
+    const app_trace_event_t *event =
+      &g_trace_ring[(head - count + i) & APP_TRACE_MASK];
+    uint8_t type = (event->type < sizeof(g_trace_type_name) /
+                                    sizeof(g_trace_type_name[0]))
+                     ? event->type
+                     : 0;
+    pos = app_trace_format_text(line, "trace ");
+    pos = app_trace_format_number(pos, (int64_t)event->time_ns);
+    pos = app_trace_format_text(pos, " ");
+    pos = app_trace_format_text(pos, g_trace_type_name[type]);
+    pos = app_trace_format_text(pos, " dev ");
+    pos = app_trace_format_number(pos, event->device);
+    pos = app_trace_format_text(pos, " dp ");
+    pos = app_trace_format_number(pos, event->id);
+    pos = app_trace_format_text(pos, " status ");
+    pos = app_trace_format_number(pos, event->status);
+    pos = app_trace_format_text(pos, " value ");
+    pos = app_trace_format_number(pos, event->value);
+    *pos++ = '\n';
+    if (APP_TRACE_WRITE(fd, line, (size_t)(pos - line)) < 0) {
+      return;
+    }
+  }
+}
+
+uint8_t *
+app_trace_cbor_head(uint8_t *pos, uint8_t major, uint64_t value)
+{
+  if (value < 24) {
+    *pos++ = (uint8_t)(major | value);
+  } else if (value < 0x100) {
+    *pos++ = (uint8_t)(major | 24);
+    *pos++ = (uint8_t)value;
+  } else if (value < 0x10000) {
+    *pos++ = (uint8_t)(major | 25);
+    *pos++ = (uint8_t)(value >> 8);
+    *pos++ = (uint8_t)value;
+  } else if (value < 0x100000000ULL) {
+    *pos++ = (uint8_t)(major | 26);
+    *pos++ = (uint8_t)(value >> 24);
+    *pos++ = (uint8_t)(value >> 16);
+    *pos++ = (uint8_t)(value >> 8);
+    *pos++ = (uint8_t)value;
+  } else {
+    int i;
+    *pos++ = (uint8_t)(major | 27);
+    for (i = 56; i >= 0; i -= 8) {
+      *pos++ = (uint8_t)(value >> i);
+    }
+  }
+  return pos;
+}
+
+/**
+ * @brief encode an event in the (little endian) layout of app_trace_event_t
+ *
+ * @return the position after the event
+ */
+static uint8_t *
+app_trace_encode_event(uint8_t *pos, const app_trace_event_t *event)
+{
+  int i;
+  for (i = 0; i < 8; i++) {
+    *pos++ = (uint8_t)(event->time_ns >> (8 * i));
+  }
+  *pos++ = (uint8_t)event->device;
+  *pos++ = (uint8_t)(event->device >> 8);
+  *pos++ = (uint8_t)event->id;
+  *pos++ = (uint8_t)((uint16_t)event->id >> 8);
+  *pos++ = event->type;
+  *pos++ = event->status;
+  *pos++ = (uint8_t)event->value;
+  *pos++ = (uint8_t)(event->value >> 8);
+  return pos;
+}
+
+/**
+ * @brief CoAP GET method of /x/trace
+ */
+static void
+app_trace_get_handler(oc_request_t *request, oc_interface_mask_t interfaces,
+                      void *user_data)
+{
+  app_trace_event_t events[APP_TRACE_MAX_GET];
+  uint8_t payload[16 + APP_TRACE_MAX_GET * APP_TRACE_EVENT_SIZE];
+  uint8_t *pos = payload;
+  int max = APP_TRACE_MAX_GET;
+  int count;
+  int i;
+  char *value;
+  int len;
+  (void)interfaces;
+  (void)user_data;
+
+  if (oc_check_accept_header(request, APPLICATION_CBOR) == false) {
+    oc_send_response(request, OC_STATUS_BAD_OPTION);
+    return;
+  }
+  len = oc_get_query_value(request, "n", &value);
+  if (len > 0) {
+    max = 0;
+    for (i = 0; i < len && value[i] >= '0' && value[i] <= '9'; i++) {
+      max = max * 10 + (value[i] - '0');
+      if (max > APP_TRACE_MAX_GET) {
+        max = APP_TRACE_MAX_GET;
+        break;
+      }
+    }
+  }
+  count = app_trace_copy(events, max);
+
+  /* { 1: recorded, 2: h'events' } */
+  pos = app_trace_cbor_head(pos, 0xA0, 2);
+  pos = app_trace_cbor_head(pos, 0x00, 1);
+  pos = app_trace_cbor_head(pos, 0x00, APP_TRACE_LOAD(&g_trace_head));
+  pos = app_trace_cbor_head(pos, 0x00, 2);
+  pos = app_trace_cbor_head(pos, 0x40,
+                            (uint32_t)(count * APP_TRACE_EVENT_SIZE));
+  for (i = 0; i < count; i++) {
+    pos = app_trace_encode_event(pos, &events[i]);
+  }
+  oc_rep_encode_raw(payload, (size_t)(pos - payload));
+  oc_send_cbor_response(request, OC_STATUS_OK);
+}
+
+void
+app_trace_register_resource(size_t device)
+{
+  oc_resource_t *res = oc_new_resource("trace", APP_TRACE_URL, 1, device);
+  oc_resource_bind_resource_type(res, "urn:knx:x.trace");
+  oc_resource_bind_content_type(res, APPLICATION_CBOR);
+  oc_resource_bind_resource_interface(res, OC_IF_D);
+  oc_resource_set_discoverable(res, true);
+  oc_resource_set_request_handler(res, OC_GET, app_trace_get_handler, NULL);
+  oc_add_resource(res);
+}
@@ -0,0 +1,157 @@
+/*
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Copyright (c) 2023 Cascoda Ltd
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+*/
+/**
+ * @file
+ *
+ * binary trace ring, shared by the virtual applications.
+ *
+ * The data point handlers record fixed size binary events (timestamp,
+ * device, data point id, event type and status) in an in-memory ring,
+ * instead of printing. Recording an event is one atomic increment and a
+ * 16 byte store, without locks or system calls; the oldest events are
+ * overwritten.
+ * The ring is dumped as text on a signal (app_trace_dump_fd is async signal
+ * safe, Linux: SIGUSR1) or read with CoAP GET on the diagnostic resource
+ * /x/trace (device 0).
+ * Tracing is compiled out with APP_TRACE_DISABLED.
+ */
+#ifndef KNX_IOT_VIRTUAL_TRACE_H
+#define KNX_IOT_VIRTUAL_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef APP_TRACE_SIZE
+#define APP_TRACE_SIZE 1024 /**< events in the ring, power of 2 */
+#endif
+
+#define APP_TRACE_URL "/x/trace" /**< the diagnostic resource */
+#define APP_TRACE_MAX_GET 64     /**< max events returned by one GET */
+
+/**
+ * @brief the event types
+ */
+typedef enum {
+  APP_TRACE_GET = 1,    /**< GET handled, status: the response code */
+  APP_TRACE_PUT = 2,    /**< PUT handled, status: the response code */
+  APP_TRACE_S_MODE = 3, /**< s-mode message sent, status: the scope */
+  APP_TRACE_NOTIFY = 4  /**< PUT published, status: the source */
+} app_trace_type_t;
+
+/**
+ * @brief a trace event (16 bytes)
+ * the CoAP resource returns the events in this layout, little endian
+ */
+typedef struct app_trace_event_t
+{
+  uint64_t time_ns; /**< monotonic time in nanoseconds */
+  uint16_t device;  /**< the device index */
+  int16_t id;       /**< the data point id, -1 == none */
+  uint8_t type;     /**< app_trace_type_t */
+  uint8_t status;   /**< depends on the type */
+  uint16_t value;   /**< depends on the type (e.g. the new value) */
+} app_trace_event_t;
+
+#ifdef APP_TRACE_DISABLED
+#define APP_TRACE(type, device, id, status, value)
+#else
+/**
+ * @brief record a trace event
+ */
+#define APP_TRACE(type, device, id, status, value)                             \
+  app_trace_add((type), (device), (id), (status), (value))
+#endif
+
+/**
+ * @brief record a trace event (use APP_TRACE)
+ *
+ * @param type the event type (app_trace_type_t)
+ * @param device the device index
+ * @param id the data point id
+ * @param status the status (depends on the type)
+ * @param value the value (depends on the type)
+ */
+void app_trace_add(uint8_t type, size_t device, int id, uint8_t status,
+                   uint16_t value);
+
+/**
+ * @brief copy the last events of the ring, oldest first
+ *
+ * @param events the events (output)
+ * @param max the max number of events to copy
+ * @return the number of events copied
+ */
+int app_trace_copy(app_trace_event_t *events, int max);
+
+/**
+ * @brief write the ring as text, oldest first
+ * async signal safe: formats without stdio, writes with write()
+ *
+ * @param fd the file descriptor (e.g. 1 == stdout)
+ */
+void app_trace_dump_fd(int fd);
+
+/**
+ * @brief append a decimal number to a text buffer (async signal safe)
+ *
+ * @param pos the position in the buffer
+ * @param number the number
+ * @return the position after the number
+ */
+char *app_trace_format_number(char *pos, int64_t number);
+
+/**
+ * @brief append a string to a text buffer (async signal safe)
+ *
+ * @param pos the position in the buffer
+ * @param text the string
+ * @return the position after the string
+ */
+char *app_trace_format_text(char *pos, const char *text);
+
+/**
+ * @brief encode the head of a CBOR item (major type and argument)
+ * used for the hand encoded payloads of the diagnostic resources
+ *
+ * @param pos the position in the buffer
+ * @param major the major type (e.g. 0x00 == unsigned, 0xA0 == map)
+ * @param value the argument
+ * @return the position after the head
+ */
+uint8_t *app_trace_cbor_head(uint8_t *pos, uint8_t major, uint64_t value);
+
+/**
+ * @brief register the diagnostic resource /x/trace
+ * GET returns { 1: number of events recorded, 2: the last events (bytes) },
+ * the query ?n= limits the number of events (max APP_TRACE_MAX_GET)
+ *
+ * @param device the device index
+ */
+void app_trace_register_resource(size_t device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KNX_IOT_VIRTUAL_TRACE_H */
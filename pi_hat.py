@@ -129,6 +129,17 @@ def set_led(led, value):
     print("Set led {} to {}".format(led, value))
     backlight.graph_set_led_state(led, value)
 
+def set_leds(mask, values):
+    """
+    Sets the LEDs of the graph in one call (called from C).
+    Args:
+      mask (int): bit per LED to update
+      values (int): bit per LED with the new state
+    """
+    for led in range(6):
+        if mask & (1 << led):
+            backlight.graph_set_led_state(led, bool(values & (1 << led)))
+
 @touch.on(touch.LEFT)
 def handle_left(_ch, _evt):
     backlight.left_rgb(*FULL_BL)